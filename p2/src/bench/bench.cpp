@@ -0,0 +1,333 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+/**
+ * Micro-benchmarks for the buffer manager and file layer.  Build with
+ * `make bench` and run `src/badgerdb_bench [section...]`; with no arguments
+ * every section runs.  Timings are wall clock and only comparable within a
+ * run.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "bench/chained_hash_tbl.h"
+#include "bufHashTbl.h"
+#include "buffer.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "file.h"
+#include "file_iterator.h"
+#include "page.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Nanoseconds per operation of running body, which performs ops operations.
+ */
+double nsPerOp(const std::uint64_t ops, const std::function<void()>& body) {
+  const auto start = std::chrono::steady_clock::now();
+  body();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / ops;
+}
+
+/**
+ * Creates a file of the given number of pages, each holding one record.
+ */
+void createFile(const std::string& filename, const PageId pages) {
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException&) {
+  }
+  File file = File::create(filename);
+  for (PageId k = 0; k < pages; k++) {
+    Page page = file.allocatePage();
+    page.insertRecord("bench record");
+    file.writePage(page);
+  }
+}
+
+/**
+ * Page accesses of a database working set: most go to a skewed hot set,
+ * some are uniform, and every so often a one-pass scan sweeps a range of
+ * the file, as a query would.
+ */
+std::vector<PageId> makeTrace(const PageId pages, const std::size_t length) {
+  std::mt19937 random(564);
+  std::uniform_real_distribution<double> unit(0, 1);
+  const PageId hot = pages / 10;
+  const PageId scanLength = pages / 2;
+  std::vector<PageId> trace;
+  while (trace.size() < length) {
+    if (trace.size() % 20000 == 19999) {
+      const PageId first = 1 + random() % (pages - scanLength);
+      for (PageId pageNo = first; pageNo < first + scanLength; pageNo++) {
+        trace.push_back(pageNo);
+      }
+      continue;
+    }
+    const double u = unit(random);
+    if (unit(random) < 0.8) {
+      trace.push_back(1 + (PageId)(hot * u * u * u));
+    } else {
+      trace.push_back(1 + (PageId)(pages * u));
+    }
+  }
+  return trace;
+}
+
+/**
+ * Replays a trace through each replacement policy, reporting the hit ratio
+ * and the cost of a readPage/unPinPage pair.
+ */
+void benchPolicies() {
+  const std::string filename = "bench.policies";
+  const PageId pages = 2000;
+  const std::uint32_t bufs = 200;
+  createFile(filename, pages);
+  const std::vector<PageId> trace = makeTrace(pages, 200000);
+  const std::map<Replacement, const char*> names = {
+      {Replacement::CLOCK, "CLOCK"},
+      {Replacement::LRU_K, "LRU_K"},
+      {Replacement::TWO_Q, "TWO_Q"}};
+  std::printf("policies: %u pages, %u frames, %zu accesses\n", pages, bufs,
+              trace.size());
+  {
+    File file = File::open(filename);
+    for (const auto& entry : names) {
+      BufMgr bufMgr(bufs, entry.first);
+      Page* page;
+      const double ns = nsPerOp(trace.size(), [&] {
+        for (PageId pageNo : trace) {
+          bufMgr.readPage(file, pageNo, page);
+          bufMgr.unPinPage(file, pageNo, false);
+        }
+      });
+      const BufStats& stats = bufMgr.getBufStats();
+      std::printf("  %-6s hit ratio %.3f  %8.1f ns/op\n", entry.second,
+                  1 - (double)stats.diskreads / stats.accesses, ns);
+    }
+  }
+  File::remove(filename);
+}
+
+/**
+ * Times insert, lookup and remove of a full pool's worth of pages, spread
+ * over two files, in BufHashTbl and in the chained table it replaced.  The
+ * tables are sized as BufMgr sizes them and accessed from one thread, so
+ * BufHashTbl's latches are not taken.
+ */
+void benchHashTable() {
+  const std::vector<std::string> filenames = {"bench.hash.1", "bench.hash.2"};
+  const PageId pagesPerFile = 32768;
+  const int htSize = ((int)(2 * pagesPerFile * 1.2) & -2) + 1;
+  const int lookupRounds = 10;
+  std::vector<File> files;
+  for (const std::string& filename : filenames) {
+    createFile(filename, 1);
+    files.push_back(File::open(filename));
+  }
+  std::vector<std::pair<std::size_t, PageId>> keys;
+  for (PageId pageNo = 1; pageNo <= pagesPerFile; pageNo++) {
+    for (std::size_t k = 0; k < files.size(); k++) {
+      keys.emplace_back(k, pageNo);
+    }
+  }
+  std::vector<std::pair<std::size_t, PageId>> probes = keys;
+  std::shuffle(probes.begin(), probes.end(), std::mt19937(564));
+  std::printf("hashtable: %zu keys, %d buckets, %d lookup rounds\n",
+              keys.size(), htSize, lookupRounds);
+
+  auto run = [&](const char* name, auto& table) {
+    FrameId frameNo = 0;
+    std::uint64_t sum = 0;
+    const double insertNs = nsPerOp(keys.size(), [&] {
+      for (const auto& key : keys) {
+        table.insert(files[key.first], key.second, frameNo++);
+      }
+    });
+    const double lookupNs = nsPerOp(keys.size() * lookupRounds, [&] {
+      for (int round = 0; round < lookupRounds; round++) {
+        for (const auto& probe : probes) {
+          table.lookup(files[probe.first], probe.second, frameNo);
+          sum += frameNo;
+        }
+      }
+    });
+    const double removeNs = nsPerOp(keys.size(), [&] {
+      for (const auto& probe : probes) {
+        table.remove(files[probe.first], probe.second);
+      }
+    });
+    std::printf("  %-8s insert %6.1f  lookup %6.1f  remove %6.1f ns/op"
+                "  (%llu)\n",
+                name, insertNs, lookupNs, removeNs, (unsigned long long)sum);
+  };
+  {
+    ChainedHashTbl chained(htSize);
+    run("chained", chained);
+  }
+  {
+    BufHashTbl flat(htSize);
+    run("flat", flat);
+  }
+  files.clear();
+  for (const std::string& filename : filenames) {
+    File::remove(filename);
+  }
+}
+
+/**
+ * Times BufHashTbl's tryLookup against the throwing lookup, for hits and
+ * for misses, over a table holding half the probed pages.
+ */
+void benchTryLookup() {
+  const std::string filename = "bench.lookup";
+  const PageId pages = 65536;
+  const int htSize = ((int)(pages * 1.2) & -2) + 1;
+  createFile(filename, 1);
+  {
+    File file = File::open(filename);
+    BufHashTbl table(htSize);
+    std::vector<PageId> hits;
+    std::vector<PageId> misses;
+    for (PageId pageNo = 1; pageNo <= pages; pageNo++) {
+      if (pageNo % 2) {
+        table.insert(file, pageNo, pageNo);
+        hits.push_back(pageNo);
+      } else {
+        misses.push_back(pageNo);
+      }
+    }
+    std::mt19937 random(564);
+    std::shuffle(hits.begin(), hits.end(), random);
+    std::shuffle(misses.begin(), misses.end(), random);
+    std::printf("lookup: %zu resident, %zu absent pages\n", hits.size(),
+                misses.size());
+
+    FrameId frameNo;
+    std::uint64_t found = 0;
+    auto timeTry = [&](const std::vector<PageId>& probes) {
+      return nsPerOp(probes.size(), [&] {
+        for (PageId pageNo : probes) {
+          found += table.tryLookup(file, pageNo, frameNo);
+        }
+      });
+    };
+    auto timeThrow = [&](const std::vector<PageId>& probes) {
+      return nsPerOp(probes.size(), [&] {
+        for (PageId pageNo : probes) {
+          try {
+            table.lookup(file, pageNo, frameNo);
+            found++;
+          } catch (const HashNotFoundException&) {
+          }
+        }
+      });
+    };
+    const double tryHit = timeTry(hits);
+    const double tryMiss = timeTry(misses);
+    const double throwHit = timeThrow(hits);
+    const double throwMiss = timeThrow(misses);
+    std::printf("  tryLookup  hit %8.1f  miss %8.1f ns/op\n", tryHit,
+                tryMiss);
+    std::printf("  lookup     hit %8.1f  miss %8.1f ns/op  (%llu found)\n",
+                throwHit, throwMiss, (unsigned long long)found);
+  }
+  File::remove(filename);
+}
+
+/**
+ * Drops the cached pages of a file, so the next read of it goes to disk.
+ */
+void dropCache(const std::string& filename) {
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  ::fdatasync(fd);
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
+/**
+ * Scans a mapped file from a cold cache with a FileIterator, once with
+ * every page used and once with every page that starts a read-ahead window
+ * freed, reporting the cost per page read.
+ */
+void benchScan() {
+  const std::string filename = "bench.scan";
+  const PageId pages = 4096;
+  // File::SCAN_AHEAD_PAGES
+  const PageId window = 32;
+  createFile(filename, pages);
+  std::printf("scan: %u pages, mapped, cold cache\n", pages);
+  for (const bool sparse : {false, true}) {
+    if (sparse) {
+      File file = File::open(filename);
+      for (PageId pageNo = window; pageNo <= pages; pageNo += window) {
+        file.deletePage(pageNo);
+      }
+    }
+    dropCache(filename);
+    std::uint64_t scanned = 0;
+    std::uint64_t sum = 0;
+    double ns;
+    {
+      File file = File::open(filename, FileBackend::MMAP);
+      ns = nsPerOp(1, [&] {
+        for (FileIterator it = file.begin(); it != file.end(); ++it) {
+          sum += (*it).page_number();
+          scanned++;
+        }
+      });
+    }
+    std::printf("  %-6s %5llu pages %8.1f ns/page\n",
+                sparse ? "sparse" : "dense", (unsigned long long)scanned,
+                ns / scanned);
+  }
+  File::remove(filename);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const std::map<std::string, std::function<void()>> sections = {
+      {"hashtable", benchHashTable},
+      {"lookup", benchTryLookup},
+      {"policies", benchPolicies},
+      {"scan", benchScan}};
+  std::vector<std::string> chosen(argv + 1, argv + argc);
+  if (chosen.empty()) {
+    for (const auto& section : sections) {
+      chosen.push_back(section.first);
+    }
+  }
+  for (const std::string& name : chosen) {
+    auto found = sections.find(name);
+    if (found == sections.end()) {
+      std::cerr << "unknown section " << name << "\n";
+      return 1;
+    }
+    found->second();
+  }
+  return 0;
+}
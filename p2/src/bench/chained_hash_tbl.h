@@ -0,0 +1,123 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "exceptions/hash_already_present_exception.h"
+#include "exceptions/hash_not_found_exception.h"
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief The original chained buffer hash table, kept only so the benchmarks
+ * can compare BufHashTbl against it.  Buckets are shared_ptr linked lists
+ * keyed by filename, as they were before BufHashTbl was replaced.
+ */
+class ChainedHashTbl {
+ public:
+  /**
+   * Constructor of ChainedHashTbl class
+   */
+  explicit ChainedHashTbl(const int htSize) : HTSIZE(htSize), ht(htSize) {}
+
+  /**
+   * Insert entry into hash table mapping (file, pageNo) to frameNo.
+   */
+  void insert(const File& file, const PageId pageNo, const FrameId frameNo) {
+    const int index = hash(file, pageNo);
+    for (auto tmpBuc = ht[index]; tmpBuc; tmpBuc = tmpBuc->next) {
+      if (tmpBuc->filename == file.filename() && tmpBuc->pageNo == pageNo) {
+        throw HashAlreadyPresentException(tmpBuc->filename, tmpBuc->pageNo,
+                                          tmpBuc->frameNo);
+      }
+    }
+    auto tmpBuc = std::make_shared<hashBucket>();
+    tmpBuc->filename = file.filename();
+    tmpBuc->pageNo = pageNo;
+    tmpBuc->frameNo = frameNo;
+    tmpBuc->next = ht[index];
+    ht[index] = tmpBuc;
+  }
+
+  /**
+   * Check if (file, pageNo) is currently in the buffer pool.
+   *
+   * @throws HashNotFoundException if the page is not in the table
+   */
+  void lookup(const File& file, const PageId pageNo, FrameId& frameNo) {
+    const int index = hash(file, pageNo);
+    for (auto tmpBuc = ht[index]; tmpBuc; tmpBuc = tmpBuc->next) {
+      if (tmpBuc->filename == file.filename() && tmpBuc->pageNo == pageNo) {
+        frameNo = tmpBuc->frameNo;
+        return;
+      }
+    }
+    throw HashNotFoundException(file.filename(), pageNo);
+  }
+
+  /**
+   * Delete entry (file, pageNo) from hash table.
+   *
+   * @throws HashNotFoundException if the page is not in the table
+   */
+  void remove(const File& file, const PageId pageNo) {
+    const int index = hash(file, pageNo);
+    std::shared_ptr<hashBucket> prevBuc;
+    for (auto tmpBuc = ht[index]; tmpBuc; tmpBuc = tmpBuc->next) {
+      if (tmpBuc->filename == file.filename() && tmpBuc->pageNo == pageNo) {
+        if (prevBuc) {
+          prevBuc->next = tmpBuc->next;
+        } else {
+          ht[index] = tmpBuc->next;
+        }
+        return;
+      }
+      prevBuc = tmpBuc;
+    }
+    throw HashNotFoundException(file.filename(), pageNo);
+  }
+
+ private:
+  /**
+   * Entry of a bucket's chain
+   */
+  struct hashBucket {
+    std::string filename;
+    PageId pageNo;
+    FrameId frameNo;
+    std::shared_ptr<hashBucket> next;
+  };
+
+  /**
+   * Bucket of (file, pageNo), hashing the filename as the original did
+   */
+  int hash(const File& file, const PageId pageNo) const {
+    const auto value = std::hash<std::string>{}(file.filename()) ^
+                       std::hash<PageId>{}(pageNo);
+    return value % HTSIZE;
+  }
+
+  /**
+   * Number of buckets
+   */
+  int HTSIZE;
+
+  /**
+   * Heads of the buckets' chains
+   */
+  std::vector<std::shared_ptr<hashBucket>> ht;
+};
+
+}  // namespace badgerdb
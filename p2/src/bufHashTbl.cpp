@@ -8,85 +8,133 @@
 
 #include "bufHashTbl.h"
 
-#include <functional>
 #include <iostream>
-#include <memory>
+#include <utility>
 
 #include "buffer.h"
 #include "exceptions/hash_already_present_exception.h"
 #include "exceptions/hash_not_found_exception.h"
-#include "exceptions/hash_table_exception.h"
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File& file, const PageId pageNo) {
-  auto hash =
-      std::hash<std::string>{}(file.filename()) ^ std::hash<PageId>{}(pageNo);
-  return hash % HTSIZE;
+std::uint64_t BufHashTbl::hash(std::uint64_t key) {
+  // splitmix64 finalizer
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return key;
 }
 
-BufHashTbl::BufHashTbl(int htSize) : HTSIZE(htSize), ht(htSize) {
-  // allocate an array of pointers to hashBuckets
+BufHashTbl::BufHashTbl(int htSize) : partitions(NUM_LATCHES) {
+  // size every partition for its share of the entries at a load factor of
+  // at most 1/2
+  std::size_t numBuckets = 8;
+  while (numBuckets * NUM_LATCHES < 2 * static_cast<std::size_t>(htSize)) {
+    numBuckets *= 2;
+  }
+  for (hashPartition& part : partitions) {
+    part.buckets.assign(numBuckets, hashBucket());
+    part.size = 0;
+  }
+}
+
+int BufHashTbl::find(const hashPartition& part, const std::uint64_t key,
+                     const std::uint64_t hashValue) {
+  const std::size_t mask = part.buckets.size() - 1;
+  std::size_t index = hashValue & mask;
+  for (std::uint32_t probeLength = 0;; probeLength++) {
+    const hashBucket& bucket = part.buckets[index];
+    // an entry closer to its home than we are to ours means the key is absent
+    if (bucket.key == 0 || bucket.probeLength < probeLength) return -1;
+    if (bucket.key == key) return index;
+    index = (index + 1) & mask;
+  }
+}
+
+void BufHashTbl::place(hashPartition& part, hashBucket entry) {
+  const std::size_t mask = part.buckets.size() - 1;
+  std::size_t index = hash(entry.key) & mask;
+  while (true) {
+    hashBucket& bucket = part.buckets[index];
+    if (bucket.key == 0) {
+      bucket = entry;
+      return;
+    }
+    // take the place of entries closer to their home bucket
+    if (bucket.probeLength < entry.probeLength) std::swap(bucket, entry);
+    index = (index + 1) & mask;
+    entry.probeLength++;
+  }
+}
+
+void BufHashTbl::grow(hashPartition& part) {
+  std::vector<hashBucket> old(part.buckets.size() * 2, hashBucket());
+  old.swap(part.buckets);
+  for (hashBucket& bucket : old) {
+    if (bucket.key != 0) {
+      bucket.probeLength = 0;
+      place(part, bucket);
+    }
+  }
 }
 
 void BufHashTbl::insert(const File& file, const PageId pageNo,
                         const FrameId frameNo) {
-  int index = hash(file, pageNo);
-
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-      throw HashAlreadyPresentException(tmpBuc->file.filename(), tmpBuc->pageNo,
-                                        tmpBuc->frameNo);
-    tmpBuc = tmpBuc->next;
-  }
+  const std::uint64_t entryKey = key(file, pageNo);
+  const std::uint64_t hashValue = hash(entryKey);
+  hashPartition& part = partition(hashValue);
+
+  const int index = find(part, entryKey, hashValue);
+  if (index >= 0)
+    throw HashAlreadyPresentException(file.filename(), pageNo,
+                                      part.buckets[index].frameNo);
+
+  // keep the load factor at most 7/8
+  if ((part.size + 1) * 8 > part.buckets.size() * 7) grow(part);
+  place(part, {entryKey, frameNo, 0});
+  part.size++;
+}
 
-  tmpBuc = std::make_shared<hashBucket>();
-  if (!tmpBuc) throw HashTableException();
+bool BufHashTbl::tryLookup(const File& file, const PageId pageNo,
+                           FrameId& frameNo) {
+  const std::uint64_t entryKey = key(file, pageNo);
+  const std::uint64_t hashValue = hash(entryKey);
+  hashPartition& part = partition(hashValue);
 
-  tmpBuc->file = file;
-  tmpBuc->pageNo = pageNo;
-  tmpBuc->frameNo = frameNo;
-  tmpBuc->next = ht[index];
-  ht[index] = tmpBuc;
+  const int index = find(part, entryKey, hashValue);
+  if (index < 0) return false;
+  frameNo = part.buckets[index].frameNo;  // return frameNo by reference
+  return true;
 }
 
 void BufHashTbl::lookup(const File& file, const PageId pageNo,
                         FrameId& frameNo) {
-  int index = hash(file, pageNo);
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-      frameNo = tmpBuc->frameNo;  // return frameNo by reference
-      return;
-    }
-    tmpBuc = tmpBuc->next;
-  }
-
-  throw HashNotFoundException(file.filename(), pageNo);
+  if (!tryLookup(file, pageNo, frameNo))
+    throw HashNotFoundException(file.filename(), pageNo);
 }
 
 void BufHashTbl::remove(const File& file, const PageId pageNo) {
-  int index = hash(file, pageNo);
-  std::shared_ptr<hashBucket> tmpBuc = ht[index];
-  std::shared_ptr<hashBucket> prevBuc;
-
-  while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo) {
-      if (prevBuc)
-        prevBuc->next = tmpBuc->next;
-      else
-        ht[index] = tmpBuc->next;
-
-      tmpBuc.reset();
-      return;
-    } else {
-      prevBuc = tmpBuc;
-      tmpBuc = tmpBuc->next;
-    }
+  const std::uint64_t entryKey = key(file, pageNo);
+  const std::uint64_t hashValue = hash(entryKey);
+  hashPartition& part = partition(hashValue);
+
+  int index = find(part, entryKey, hashValue);
+  if (index < 0) throw HashNotFoundException(file.filename(), pageNo);
+
+  // shift the following entries of the probe sequence back by one
+  const std::size_t mask = part.buckets.size() - 1;
+  std::size_t hole = index;
+  std::size_t next = (hole + 1) & mask;
+  while (part.buckets[next].key != 0 && part.buckets[next].probeLength > 0) {
+    part.buckets[hole] = part.buckets[next];
+    part.buckets[hole].probeLength--;
+    hole = next;
+    next = (next + 1) & mask;
   }
-
-  throw HashNotFoundException(file.filename(), pageNo);
+  part.buckets[hole] = hashBucket();
+  part.size--;
 }
 
 }  // namespace badgerdb
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <cstdint>
+#include <mutex>
 #include <vector>
 
 #include "file.h"
@@ -19,57 +21,137 @@ namespace badgerdb {
  */
 struct hashBucket {
   /**
-   * pointer a file object (more on this below)
+   * File id in the upper and page number in the lower 32 bits, or 0 if the
+   * bucket is empty
    */
-  File file;
+  std::uint64_t key;
 
   /**
-   * page number within a file
+   * frame number of page in the buffer pool
    */
-  PageId pageNo;
+  FrameId frameNo;
 
   /**
-   * frame number of page in the buffer pool
+   * Distance of the bucket from the one the key hashes to
    */
-  FrameId frameNo;
+  std::uint32_t probeLength;
+};
+
+/**
+ * @brief One independently latched part of the hash table
+ */
+struct hashPartition {
+  /**
+   * Open-addressed buckets; the count is a power of two
+   */
+  std::vector<hashBucket> buckets;
+
+  /**
+   * Number of occupied buckets
+   */
+  std::uint32_t size;
 
   /**
-   * Next node in the hash table
+   * Latch protecting the buckets of this partition
    */
-  std::shared_ptr<hashBucket> next;
+  std::mutex latch;
 };
 
 /**
  * @brief Hash table class to keep track of pages in the buffer pool
  *
- * @warning This class is not threadsafe.
+ * Entries are keyed on (file id, page number) and stored inline in
+ * open-addressed buckets using Robin Hood probing with backward-shift
+ * deletion, so no operation allocates except when a partition grows.
+ *
+ * The table is split into NUM_LATCHES partitions, each with its own latch.
+ * insert(), lookup() and remove() do no locking of their own; callers must
+ * hold the latch returned by latch() for the (file, pageNo) they operate on.
+ * Operations on pages in different partitions may then proceed in parallel.
  */
 class BufHashTbl {
  private:
   /**
-   *	Size of Hash Table
+   * Number of partitions, and so of latches.  Must be a power of two.
    */
-  int HTSIZE;
+  static const int NUM_LATCHES = 64;
+
   /**
-   * Actual Hash table object
+   * Partitions of the table
    */
-  std::vector<std::shared_ptr<hashBucket>> ht;
+  std::vector<hashPartition> partitions;
 
   /**
-   * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+   * Returns the key of (file, pageNo).
    *
    * @param file   	File object
    * @param pageNo  Page number in the file
+   * @return  			Key of the entry.
+   */
+  static std::uint64_t key(const File& file, const PageId pageNo) {
+    return (static_cast<std::uint64_t>(file.id()) << 32) | pageNo;
+  }
+
+  /**
+   * returns a well mixed hash value of a key.  The high bits select the
+   * partition and the low bits the bucket within it.
+   *
+   * @param key   	Key of the entry
    * @return  			Hash value.
    */
-  int hash(const File& file, const PageId pageNo);
+  static std::uint64_t hash(std::uint64_t key);
+
+  /**
+   * Returns the partition a hash value belongs to.
+   */
+  hashPartition& partition(const std::uint64_t hashValue) {
+    return partitions[(hashValue >> 58) & (NUM_LATCHES - 1)];
+  }
+
+  /**
+   * Returns the index of the bucket holding a key, or -1 if not present.
+   *
+   * @param part   	Partition to search
+   * @param key   	Key of the entry
+   * @param hashValue Hash of the key
+   */
+  static int find(const hashPartition& part, const std::uint64_t key,
+                  const std::uint64_t hashValue);
+
+  /**
+   * Places an entry in a partition that has room for it.
+   *
+   * @param part   	Partition to insert into
+   * @param entry   Entry to insert, with probeLength 0
+   */
+  static void place(hashPartition& part, hashBucket entry);
+
+  /**
+   * Doubles the number of buckets in a partition.
+   *
+   * @param part   	Partition to grow
+   */
+  static void grow(hashPartition& part);
 
  public:
   /**
    * Constructor of BufHashTbl class
+   *
+   * @param htSize  Number of entries the table should hold without growing
    */
   BufHashTbl(const int htSize);  // constructor
 
+  /**
+   * Returns the latch protecting the entry of (file, pageNo).
+   *
+   * @param file   	File object
+   * @param pageNo  Page number in the file
+   * @return  			Latch to hold while operating on that entry.
+   */
+  std::mutex& latch(const File& file, const PageId pageNo) {
+    return partition(hash(key(file, pageNo))).latch;
+  }
+
   /**
    * Insert entry into hash table mapping (file, pageNo) to frameNo.
    *
@@ -78,11 +160,20 @@ class BufHashTbl {
    * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page
    * already exists in the hash table
-   * @throws  HashTableException (optional) if could not create a new bucket as
-   * running of memory
    */
   void insert(const File& file, const PageId pageNo, const FrameId frameNo);
 
+  /**
+   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * the hash table) without throwing if it is not.
+   *
+   * @param file  	File object
+   * @param pageNo	Page number in the file
+   * @param frameNo Frame number reference, set only if the page is found
+   * @return  True if the page entry is in the hash table
+   */
+  bool tryLookup(const File& file, const PageId pageNo, FrameId& frameNo);
+
   /**
    * Check if (file, pageNo) is currently in the buffer pool (ie. in
    * the hash table).
@@ -8,15 +8,18 @@
 
 #include "buffer.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 
 #include "exceptions/bad_buffer_exception.h"
+#include "exceptions/badgerdb_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
-#include "exceptions/hash_not_found_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
-#include "exceptions/invalid_page_exception.h"
 namespace badgerdb {
 
 constexpr int HASHTABLE_SZ(int bufs) { return ((int)(bufs * 1.2) & -2) + 1; }
@@ -24,123 +27,616 @@ constexpr int HASHTABLE_SZ(int bufs) { return ((int)(bufs * 1.2) & -2) + 1; }
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
-BufMgr::BufMgr(std::uint32_t bufs)
+BufMgr::BufMgr(std::uint32_t bufs, Replacement replacement,
+               const PoolMemory& memory, const IoEngineKind ioEngine)
     : numBufs(bufs),
       hashTable(HASHTABLE_SZ(bufs)),
       bufDescTable(bufs),
-      bufPool(bufs) {
+      scanRingSize(std::max<std::uint32_t>(
+          1, std::min<std::uint32_t>(SCAN_RING_MAX, bufs / 8))),
+      readAheadPages(0),
+      prefetchingFile(File::INVALID_ID),
+      prefetchStopping(false),
+      writerCleanTarget(0),
+      writerRate(0),
+      writerHand(0),
+      writerStopping(false),
+      io(IoEngine::create(ioEngine)),
+      bufPool(bufs, memory) {
     for (FrameId i = 0; i < bufs; i++) {
         bufDescTable[i].frameNo = i;
         bufDescTable[i].valid = false;
     }
-    clockHand = bufs - 1;
+    switch (replacement) {
+    case Replacement::LRU_K:
+        policy.reset(new LruKPolicy(bufs));
+        break;
+    case Replacement::TWO_Q:
+        policy.reset(new TwoQPolicy(bufs));
+        break;
+    default:
+        policy.reset(new ClockPolicy(bufDescTable));
+        break;
+    }
 }
 
-/**
- * @brief Advance clock to next frame in the buffer pool
- * 
- */
-void BufMgr::advanceClock() {
-  clockHand = (clockHand + 1) % numBufs;
+//----------------------------------------
+// Destructor of the class BufMgr
+//----------------------------------------
+BufMgr::~BufMgr() {
+    stopBackgroundWriter();
+    {
+        std::lock_guard<std::mutex> guard(prefetchLatch);
+        prefetchStopping = true;
+    }
+    prefetchQueued.notify_all();
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+    }
 }
 
 /**
- * @brief Allocate a free frame
+ * @brief Allocate a free frame. The frame's latch is held on return.
  * 
  * @param frame frame to be allocated
  */
 void BufMgr::allocBuf(FrameId& frame) {
-    advanceClock();
-    // mark the starting clock hand position
-    uint start = clockHand;
-    // flag for whether the clock has started
-    bool started = false;
-    // flag for whether the clock is on the second pass
-    bool secondPass = false;
-    // flag for whether the clock is on the second pass + 1 buffer
-    bool temp = false;
-    while(true){
-        // if clock has started and ran one revolution
-        if(clockHand == start && started == true) {
-            // if not second pass, set to true
-            if (!secondPass) {
-                secondPass = true;
-            }
-        // if clock hand ran 1 revolution + 1 buffer, set the temp flag
-        } else if (clockHand == (start + 1) % numBufs && secondPass && !temp) {
-            temp = true;
-        // if clock hand ran 2 revolution + 1 buffer
-        } else if (clockHand == (start + 1) % numBufs && secondPass && temp) {
-            throw BufferExceededException();
+    std::unique_lock<std::mutex> frameGuard;
+    // claiming must not block, as the policy may hold its own latch
+    auto tryClaim = [&](FrameId candidate) {
+        BufDesc& desc = bufDescTable[candidate];
+        // if page is pinned, skip this page
+        if (desc.pinCnt > 0) {
+            return false;
+        }
+        // skip frames another thread is evicting, loading or flushing
+        std::unique_lock<std::mutex> guard(desc.latch, std::try_to_lock);
+        if (!guard.owns_lock()) {
+            return false;
+        }
+        frameGuard = std::move(guard);
+        return true;
+    };
+    for (std::uint32_t i = 0; i < numBufs; i++) {
+        if (!policy->pickVictim(tryClaim, frame)) {
+            break;
+        }
+        BufDesc& desc = bufDescTable[frame];
+        bool evicted;
+        try {
+            evicted = !desc.valid || evictFrame(desc);
+        } catch (...) {
+            // the write back failed and the page stays resident; give the
+            // frame back to the policy, which would otherwise never offer it
+            // again
+            frameGuard.unlock();
+            policy->loaded(frame);
+            throw;
+        }
+        if (evicted) {
+            // the clock sweeps scan ring frames too
+            leaveScanRing(frame);
+            // hand the latched frame over to the caller
+            frameGuard.release();
             return;
         }
+        // the page got pinned or dirtied again; keep it resident
+        frameGuard.unlock();
+        policy->loaded(frame);
+    }
+    throw BufferExceededException();
+}
 
-        started = true;
-        if(bufDescTable[clockHand].valid == true){
-            // if refbit is 1 & page is valid, flip refbit to 0
-           if(bufDescTable[clockHand].refbit == false) {
-                // if page is pinned, skip this page
-                if(bufDescTable[clockHand].pinCnt == 0) {
-                    // if page is dirty & valid & unpinned, write
-                    if(bufDescTable[clockHand].dirty == true) {
-                        // if page is dirty, flush
-                        //call set on the frame()
-                        //flushFile(bufDescTable[clockHand].file);
-                        bufDescTable[clockHand].file.writePage(bufPool[clockHand]);
-                        bufDescTable[clockHand].dirty = false;
-                    }
-                    // else, set frame, remove from buffer and continue
-                    bufDescTable[clockHand].Set(bufDescTable[clockHand].file,bufDescTable[clockHand].pageNo);
-                    hashTable.remove(bufDescTable[clockHand].file,bufDescTable[clockHand].pageNo);
-                    break;
-                } else {
-                    advanceClock();
-                    continue;
-                }
-            } else {
-                // flip the refbit
-                bufDescTable[clockHand].refbit = false;
-                advanceClock();
-                continue;
+/**
+ * @brief Record that a page of a file is resident in a frame. The caller
+ * holds the page's hash table latch.
+ *
+ * @param fileId
+ * @param pageNo
+ * @param frame
+ */
+void BufMgr::indexFrame(const FileId fileId, const PageId pageNo,
+                        const FrameId frame) {
+    std::lock_guard<std::mutex> guard(fileFramesLatch);
+    fileFrames[fileId][pageNo] = frame;
+}
+
+/**
+ * @brief Record that a page of a file is no longer resident. The caller
+ * holds the page's hash table latch.
+ *
+ * @param fileId
+ * @param pageNo
+ */
+void BufMgr::unindexFrame(const FileId fileId, const PageId pageNo) {
+    std::lock_guard<std::mutex> guard(fileFramesLatch);
+    auto found = fileFrames.find(fileId);
+    if (found == fileFrames.end()) {
+        return;
+    }
+    found->second.erase(pageNo);
+    if (found->second.empty()) {
+        fileFrames.erase(found);
+    }
+}
+
+/**
+ * @brief Write back and unmap the page held in a frame
+ *
+ * @param desc descriptor of the frame, latched by the caller
+ * @return false if the page got pinned or dirtied while writing it back
+ */
+bool BufMgr::evictFrame(BufDesc& desc) {
+    // Write back while the page is still mapped, so a thread missing on it
+    // cannot read the stale copy from disk in between.
+    if (desc.dirty.exchange(false)) {
+        try {
+            desc.file.writePage(bufPool[desc.frameNo]);
+        } catch (...) {
+            desc.dirty = true;
+            throw;
+        }
+        bufStats.diskwrites++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(
+            hashTable.latch(desc.file, desc.pageNo));
+        if (desc.pinCnt > 0 || desc.dirty) {
+            return false;
+        }
+        hashTable.remove(desc.file, desc.pageNo);
+        unindexFrame(desc.fileId, desc.pageNo);
+    }
+    desc.clear();
+    return true;
+}
+
+/**
+ * @brief Reuse the oldest free frame of a full scan ring. The frame's latch
+ * is held on return.
+ *
+ * @param frame frame to be reused
+ * @return false if the ring is not full yet or all its frames are busy
+ */
+bool BufMgr::allocScanBuf(FrameId& frame) {
+    std::unique_lock<std::mutex> guard(scanRingLatch);
+    if (scanRing.size() < scanRingSize) {
+        return false;
+    }
+    for (auto it = scanRing.begin(); it != scanRing.end(); ++it) {
+        BufDesc& desc = bufDescTable[*it];
+        if (desc.pinCnt > 0) {
+            continue;
+        }
+        std::unique_lock<std::mutex> frameGuard(desc.latch, std::try_to_lock);
+        if (!frameGuard.owns_lock()) {
+            continue;
+        }
+        bool evicted;
+        try {
+            evicted = !desc.valid || evictFrame(desc);
+        } catch (...) {
+            // the write back failed and the page stays resident; move it to
+            // the working set, so the ring does not retry it on every scan
+            const FrameId failed = *it;
+            desc.inScanRing = false;
+            scanRing.erase(it);
+            frameGuard.unlock();
+            guard.unlock();
+            policy->loaded(failed);
+            throw;
+        }
+        if (!evicted) {
+            continue;
+        }
+        frame = *it;
+        desc.inScanRing = false;
+        scanRing.erase(it);
+        frameGuard.release();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Add a frame loaded by a sequential scan to the scan ring
+ *
+ * @param frame frame to add
+ * @return false if the ring is full
+ */
+bool BufMgr::joinScanRing(const FrameId frame) {
+    std::lock_guard<std::mutex> guard(scanRingLatch);
+    if (scanRing.size() >= scanRingSize) {
+        return false;
+    }
+    scanRing.push_back(frame);
+    bufDescTable[frame].inScanRing = true;
+    return true;
+}
+
+/**
+ * @brief Take a frame out of the scan ring
+ *
+ * @param frame frame to remove
+ * @return true if the frame was in the ring
+ */
+bool BufMgr::leaveScanRing(const FrameId frame) {
+    if (!bufDescTable[frame].inScanRing) {
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(scanRingLatch);
+    auto it = std::find(scanRing.begin(), scanRing.end(), frame);
+    if (it == scanRing.end()) {
+        return false;
+    }
+    scanRing.erase(it);
+    bufDescTable[frame].inScanRing = false;
+    return true;
+}
+
+/**
+ * @brief Count an access to a resident page
+ *
+ * @param frame frame holding the page
+ * @param hint hint the page was asked for with
+ */
+void BufMgr::noteAccess(const FrameId frame, const AccessHint hint) {
+    if (bufDescTable[frame].prefetched.exchange(false)) {
+        bufStats.prefetchhits++;
+    }
+    if (hint != AccessHint::RANDOM) {
+        return;
+    }
+    // a page first read by a scan joins the working set once it is used
+    // outside the scan
+    if (leaveScanRing(frame)) {
+        policy->loaded(frame);
+    } else {
+        policy->accessed(frame);
+    }
+}
+
+/**
+ * @brief Claim a frame to load a page into. The frame's latch is held on
+ * return.
+ *
+ * @param hint
+ * @return the claimed frame
+ */
+FrameId BufMgr::claimFrame(const AccessHint hint) {
+    FrameId frameNo;
+    if (hint != AccessHint::SEQUENTIAL || !allocScanBuf(frameNo)) {
+        allocBuf(frameNo);
+    }
+    return frameNo;
+}
+
+/**
+ * @brief Map a page just read into a claimed frame
+ *
+ * @param file
+ * @param pageNo
+ * @param frameNo latched frame holding the page
+ * @param hint
+ * @param prefetch true to leave the page unpinned, as read ahead
+ * @return the frame holding the page
+ */
+FrameId BufMgr::installPage(File& file, const PageId pageNo,
+                            const FrameId frameNo, const AccessHint hint,
+                            const bool prefetch) {
+    FrameId loadedFrameNo;
+    {
+        std::lock_guard<std::mutex> guard(hashTable.latch(file, pageNo));
+        // another thread may have read the same page in the meantime; if so
+        // use its frame and leave ours invalid
+        if (hashTable.tryLookup(file, pageNo, loadedFrameNo)) {
+            if (!prefetch) {
+                bufDescTable[loadedFrameNo].pinCnt++;
             }
         } else {
-            // set frame
-            bufDescTable[clockHand].Set(bufDescTable[clockHand].file,bufDescTable[clockHand].pageNo);
-            break;
+            loadedFrameNo = frameNo;
+            hashTable.insert(file, pageNo, frameNo);
+            indexFrame(file.id(), pageNo, frameNo);
+            bufDescTable[frameNo].Set(file,pageNo);
+            if (prefetch) {
+                bufDescTable[frameNo].pinCnt = 0;
+                bufDescTable[frameNo].prefetched = true;
+            }
+        }
+    }
+    if (loadedFrameNo != frameNo) {
+        policy->freed(frameNo);
+        if (!prefetch) {
+            noteAccess(loadedFrameNo, hint);
+        }
+    } else if (hint == AccessHint::ONE_SHOT) {
+        policy->loadedCold(frameNo);
+    } else if (hint != AccessHint::SEQUENTIAL || !joinScanRing(frameNo)) {
+        policy->loaded(frameNo);
+    }
+    return loadedFrameNo;
+}
+
+/**
+ * @brief Read a page missing from the buffer pool into a frame
+ *
+ * @param file
+ * @param pageNo
+ * @param hint
+ * @param prefetch true to leave the page unpinned, as read ahead
+ * @return the frame holding the page
+ */
+FrameId BufMgr::loadPage(File& file, const PageId pageNo,
+                         const AccessHint hint, const bool prefetch) {
+    const FrameId frameNo = claimFrame(hint);
+    std::unique_lock<std::mutex> frameGuard(bufDescTable[frameNo].latch,
+                                            std::adopt_lock);
+    // read straight into the frame; if the page turns out to be invalid the
+    // frame is released still marked invalid
+    try {
+        file.readPage(pageNo, bufPool[frameNo]);
+    } catch (...) {
+        policy->freed(frameNo);
+        throw;
+    }
+    if (prefetch) {
+        bufStats.prefetchreads++;
+    } else {
+        bufStats.diskreads++;
+    }
+    return installPage(file, pageNo, frameNo, hint, prefetch);
+}
+
+/**
+ * @brief Queue read-ahead for a file that is being read page after page
+ *
+ * @param file
+ * @param pageNo page just asked for
+ * @param hint
+ */
+void BufMgr::noteSequential(File& file, const PageId pageNo,
+                            const AccessHint hint) {
+    const std::uint32_t window = readAheadPages;
+    if (window == 0 || hint == AccessHint::ONE_SHOT) {
+        return;
+    }
+    PageId first;
+    {
+        std::lock_guard<std::mutex> guard(readAheadLatch);
+        auto found = readAhead.find(file.id());
+        if (found == readAhead.end()) {
+            readAhead.emplace(file.id(), ReadAheadState{pageNo, pageNo});
+            return;
         }
+        ReadAheadState& state = found->second;
+        const bool sequential = (pageNo == state.lastPage + 1);
+        state.lastPage = pageNo;
+        if (!sequential) {
+            state.prefetchedThrough = pageNo;
+            return;
+        }
+        // top the window up once half of it has been consumed
+        if (state.prefetchedThrough >= pageNo + window / 2 + 1) {
+            return;
+        }
+        first = std::max(state.prefetchedThrough, pageNo) + 1;
+        state.prefetchedThrough = pageNo + window;
     }
-    // update frame
-    frame = clockHand;
+    prefetch(file, first, pageNo + window - first + 1, hint);
 }
 
 /**
- * @brief Reads the given page from the file into a frame and returns the pointer to page
+ * @brief Reads the given page from the file into a frame and returns the
+ * pointer to page
  * If the requested page is already present in the buffer pool
  * pointer to that frame is returned, otherwise a new fame is 
  * allocated from the buffer pool for reading the page
  * @param file 
  * @param pageNo 
  * @param page 
+ * @param hint
  */
-void BufMgr::readPage(File& file, const PageId pageNo, Page*& page) {
+void BufMgr::readPage(File& file, const PageId pageNo, Page*& page,
+                      const AccessHint hint) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
     FrameId frameNo;
+    bool hit;
+    bufStats.accesses++;
+    {
+        std::lock_guard<std::mutex> guard(hashTable.latch(file, pageNo));
+        hit = hashTable.tryLookup(file, pageNo, frameNo);
+        if (hit) {
+            bufDescTable[frameNo].pinCnt++;
+        }
+    }
+    if (hit) {
+        noteAccess(frameNo, hint);
+    } else {
+        frameNo = loadPage(file, pageNo, hint, false);
+    }
+    page = & bufPool[frameNo];
+    noteSequential(file, pageNo, hint);
+}
+
+/**
+ * @brief read and pin a batch of pages, merging the misses into runs
+ * @param requests pages to read; page is set for each
+ * @param hint
+ */
+void BufMgr::readPages(std::vector<PageRequest>& requests,
+                       const AccessHint hint) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    for (PageRequest& request : requests) {
+        request.page = nullptr;
+    }
     try {
-        hashTable.lookup(file, pageNo, frameNo);
-        bufDescTable[frameNo].refbit = true;
-        bufDescTable[frameNo].pinCnt++;
-        page = & bufPool[frameNo];
-    } catch (const HashNotFoundException &) {
-        try {
-            file.readPage(pageNo);
-        } catch (const InvalidPageException &) {
-            throw InvalidPageException(pageNo, file.filename());
-            return;
+        std::vector<PageRequest*> misses;
+        for (PageRequest& request : requests) {
+            FrameId frameNo;
+            bool hit;
+            bufStats.accesses++;
+            {
+                std::lock_guard<std::mutex> guard(
+                    hashTable.latch(*request.file, request.pageNo));
+                hit = hashTable.tryLookup(*request.file, request.pageNo,
+                                          frameNo);
+                if (hit) {
+                    bufDescTable[frameNo].pinCnt++;
+                }
+            }
+            if (hit) {
+                noteAccess(frameNo, hint);
+                request.page = & bufPool[frameNo];
+            } else {
+                misses.push_back(&request);
+            }
         }
-        allocBuf(frameNo);
-        bufPool[frameNo] = file.readPage(pageNo);
-        hashTable.insert(file, pageNo, frameNo);
-        bufDescTable[frameNo].Set(file,pageNo);
-        page = & bufPool[frameNo];
+        std::sort(misses.begin(), misses.end(),
+                  [](const PageRequest* a, const PageRequest* b) {
+                      return std::make_pair(a->file->id(), a->pageNo) <
+                             std::make_pair(b->file->id(), b->pageNo);
+                  });
+        // a run is a group of consecutive pages of one file; runs are read
+        // together in batches, both bounded so that their frames do not
+        // crowd out the rest of the pool
+        const PageId maxBatch = std::max<std::uint32_t>(1, numBufs / 4);
+        const PageId maxRun = std::min<std::uint32_t>(MAX_READ_RUN, maxBatch);
+        std::vector<std::vector<PageRequest*>> runs;
+        PageId batchPages = 0;
+        for (PageRequest* miss : misses) {
+            if (!runs.empty()) {
+                const PageRequest* first = runs.back().front();
+                const PageRequest* last = runs.back().back();
+                if (miss->file->id() == first->file->id() &&
+                    miss->pageNo == last->pageNo) {
+                    runs.back().push_back(miss);
+                    continue;
+                }
+                const bool extends = miss->file->id() == first->file->id() &&
+                                     miss->pageNo == last->pageNo + 1 &&
+                                     miss->pageNo - first->pageNo < maxRun;
+                if (batchPages == maxBatch) {
+                    readRuns(runs, hint);
+                    runs.clear();
+                    batchPages = 0;
+                } else if (extends) {
+                    runs.back().push_back(miss);
+                    batchPages++;
+                    continue;
+                }
+            }
+            runs.emplace_back(1, miss);
+            batchPages++;
+        }
+        if (!runs.empty()) {
+            readRuns(runs, hint);
+        }
+    } catch (...) {
+        // leave nothing pinned on behalf of a failed batch
+        for (PageRequest& request : requests) {
+            if (request.page != nullptr) {
+                unPin(*request.file, request.pageNo, false);
+                request.page = nullptr;
+            }
+        }
+        throw;
+    }
+}
+
+/**
+ * @brief read runs of consecutive missing pages, all at once, and pin them
+ * @param runs requests for each run, sorted by page number; equal pages are
+ * pinned once for each request
+ * @param hint
+ */
+void BufMgr::readRuns(const std::vector<std::vector<PageRequest*>>& runs,
+                      const AccessHint hint) {
+    std::vector<FrameRun> frameRuns;
+    std::vector<std::unique_lock<std::mutex>> frameGuards;
+    try {
+        for (const std::vector<PageRequest*>& run : runs) {
+            frameRuns.push_back(
+                FrameRun{run.front()->file, run.front()->pageNo, {}});
+            const PageId runLength =
+                run.back()->pageNo - run.front()->pageNo + 1;
+            for (PageId i = 0; i < runLength; i++) {
+                const FrameId frameNo = claimFrame(hint);
+                frameRuns.back().frames.push_back(frameNo);
+                frameGuards.emplace_back(bufDescTable[frameNo].latch,
+                                         std::adopt_lock);
+            }
+        }
+        readFrameRuns(frameRuns);
+    } catch (...) {
+        // the claimed frames are released still marked invalid
+        for (const FrameRun& frameRun : frameRuns) {
+            for (FrameId frameNo : frameRun.frames) {
+                policy->freed(frameNo);
+            }
+        }
+        throw;
+    }
+
+    for (std::size_t i = 0; i < runs.size(); i++) {
+        File& file = *frameRuns[i].file;
+        const PageId firstPage = frameRuns[i].firstPage;
+        bufStats.diskreads += frameRuns[i].frames.size();
+        FrameId frameNo = 0;
+        PageId previous = Page::INVALID_NUMBER;
+        for (PageRequest* request : runs[i]) {
+            if (request->pageNo != previous) {
+                frameNo = installPage(
+                    file, request->pageNo,
+                    frameRuns[i].frames[request->pageNo - firstPage], hint,
+                    false);
+                previous = request->pageNo;
+            } else {
+                std::lock_guard<std::mutex> guard(
+                    hashTable.latch(file, request->pageNo));
+                bufDescTable[frameNo].pinCnt++;
+            }
+            request->page = & bufPool[frameNo];
+        }
+    }
+}
+
+/**
+ * @brief read runs into their claimed frames with all the reads in flight
+ * @param runs
+ */
+void BufMgr::readFrameRuns(const std::vector<FrameRun>& runs) {
+    std::vector<std::vector<Page*>> pages(runs.size());
+    std::vector<IoRequest> requests(runs.size());
+    IoBatch batch;
+    try {
+        for (std::size_t i = 0; i < runs.size(); i++) {
+            for (FrameId frameNo : runs[i].frames) {
+                pages[i].push_back(& bufPool[frameNo]);
+            }
+            runs[i].file->startReadPages(*io, batch, requests[i],
+                                         runs[i].firstPage, pages[i]);
+        }
+    } catch (...) {
+        // the reads already started must land before the frames are reused
+        batch.wait();
+        throw;
+    }
+    batch.wait();
+    for (std::size_t i = 0; i < runs.size(); i++) {
+        runs[i].file->finishReadPages(requests[i], runs[i].firstPage, pages[i]);
+    }
+}
+
+/**
+ * @brief unpin a batch of pages
+ * @param requests pages to unpin
+ * @param dirty
+ */
+void BufMgr::unPinPages(const std::vector<PageRequest>& requests,
+                        const bool dirty) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    for (const PageRequest& request : requests) {
+        unPin(*request.file, request.pageNo, dirty);
     }
 }
 
@@ -151,23 +647,34 @@ void BufMgr::readPage(File& file, const PageId pageNo, Page*& page) {
  * @param dirty
  */
 void BufMgr::unPinPage(File& file, const PageId pageNo, const bool dirty) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    unPin(file, pageNo, dirty);
+}
+
+/**
+ * @brief unpin a page; the caller holds the resize latch
+ * @param file
+ * @param pageNo
+ * @param dirty
+ */
+void BufMgr::unPin(File& file, const PageId pageNo, const bool dirty) {
     FrameId frameNo;
+    std::lock_guard<std::mutex> guard(hashTable.latch(file, pageNo));
     // check if page is found
-    try {
-        hashTable.lookup(file, pageNo, frameNo);
-    } catch (const HashNotFoundException &) {
+    if (!hashTable.tryLookup(file, pageNo, frameNo)) {
         return;
     }
     // check if pin count is already 0
     if (bufDescTable[frameNo].pinCnt <= 0) {
-        throw PageNotPinnedException(file.filename(), bufDescTable[frameNo].pageNo, frameNo);
+        throw PageNotPinnedException(file.filename(),
+                                     bufDescTable[frameNo].pageNo, frameNo);
         return;
     }
-    // decrement pc, set dirty
-    bufDescTable[frameNo].pinCnt--;
+    // set dirty, decrement pc
     if (dirty == true) {
         bufDescTable[frameNo].dirty = true;
     }
+    bufDescTable[frameNo].pinCnt--;
 }
 
 
@@ -178,43 +685,152 @@ void BufMgr::unPinPage(File& file, const PageId pageNo, const bool dirty) {
  * @param page, set reference
  */
 void BufMgr::allocPage(File& file, PageId& pageNo, Page*& page) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
     FrameId frame;
     
-    //still need to set pageNo somehow...
+    bufStats.accesses++;
     Page newPage = file.allocatePage(); 
     pageNo = newPage.page_number();
     allocBuf(frame); //get buffer pool frame
-    hashTable.insert(file,pageNo,frame);//insert into hashtable
+    std::unique_lock<std::mutex> frameGuard(bufDescTable[frame].latch,
+                                            std::adopt_lock);
     bufPool[frame] = newPage; //allocate new page
-    bufDescTable[frame].Set(file,pageNo); //set the frame
+    {
+        std::lock_guard<std::mutex> guard(hashTable.latch(file, pageNo));
+        hashTable.insert(file,pageNo,frame);//insert into hashtable
+        indexFrame(file.id(), pageNo, frame);
+        bufDescTable[frame].Set(file,pageNo); //set the frame
+    }
+    policy->loaded(frame);
     page = &bufPool[frame]; //set page
 }
 
 /**
- * @brief flush a file. Close all bufDescTable entries in the given file, and remove from hashTable
+ * @brief flush a file. Write back its dirty pages in page order, clear all
+ * bufDescTable entries in the given file, and remove them from hashTable
  * @param file 
+ * @return what was written
  */
-void BufMgr::flushFile(File& file) {
-    for (uint32_t i = 0; i < numBufs; i++){
-        if (bufDescTable[i].file == file) {
+FlushReport BufMgr::flushFile(File& file) {
+    const auto start = std::chrono::steady_clock::now();
+    FlushReport report = {0, 0, 0, std::chrono::microseconds(0)};
+    // drop read-ahead of the file and let a run in progress finish, so no
+    // page of it is loaded behind the sweep
+    {
+        std::unique_lock<std::mutex> lock(prefetchLatch);
+        std::deque<PrefetchRequest> kept;
+        for (const PrefetchRequest& request : prefetchQueue) {
+            if (request.file.id() != file.id()) {
+                kept.push_back(request);
+            }
+        }
+        prefetchQueue.swap(kept);
+        prefetchDone.wait(lock, [&] { return prefetchingFile != file.id(); });
+    }
+    {
+        std::lock_guard<std::mutex> guard(readAheadLatch);
+        readAhead.erase(file.id());
+    }
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    // only the frames indexed under the file need looking at
+    std::vector<FrameId> candidates;
+    {
+        std::lock_guard<std::mutex> guard(fileFramesLatch);
+        auto found = fileFrames.find(file.id());
+        if (found != fileFrames.end()) {
+            for (const auto& entry : found->second) {
+                candidates.push_back(entry.second);
+            }
+        }
+    }
+    // latch them in frame order, like any other sweep; a page evicted in the
+    // meantime is skipped
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<FrameId> frames;
+    std::vector<std::unique_lock<std::mutex>> frameGuards;
+    for (FrameId i : candidates) {
+        std::unique_lock<std::mutex> frameGuard(bufDescTable[i].latch);
+        if (bufDescTable[i].fileId == file.id()) {
             // pincount needs to be == 0
             if (bufDescTable[i].pinCnt > 0) {
-                throw PagePinnedException(file.filename(), bufDescTable[i].pageNo, i);
+                throw PagePinnedException(file.filename(),
+                                          bufDescTable[i].pageNo, i);
             }
             // badbuffer exception
             if (!bufDescTable[i].valid) {
-                throw BadBufferException(i, bufDescTable[i].dirty, bufDescTable[i].valid, bufDescTable[i].refbit);
+                throw BadBufferException(i, bufDescTable[i].dirty,
+                                         bufDescTable[i].valid,
+                                         bufDescTable[i].refbit);
             }
-            // if the dirty bit is set, write back to disk first
-            if (bufDescTable[i].dirty == true) {
-                bufDescTable[i].file.writePage(bufPool[i]);
-                bufDescTable[i].dirty = false;
+            frames.push_back(i);
+            frameGuards.push_back(std::move(frameGuard));
+        }
+    }
+    // write the dirty pages back in page order, a run of adjacent pages per
+    // write and all the writes in flight at once
+    std::sort(frames.begin(), frames.end(), [this](FrameId a, FrameId b) {
+        return bufDescTable[a].pageNo < bufDescTable[b].pageNo;
+    });
+    std::vector<PageRun> runs;
+    std::vector<FrameId> written;
+    PageId previous = Page::INVALID_NUMBER;
+    for (FrameId frameNo : frames) {
+        BufDesc& desc = bufDescTable[frameNo];
+        if (!desc.dirty) {
+            continue;
+        }
+        if (runs.empty() || previous + 1 != desc.pageNo) {
+            runs.push_back(PageRun{desc.pageNo, {}});
+        }
+        runs.back().pages.push_back(& bufPool[frameNo]);
+        written.push_back(frameNo);
+        previous = desc.pageNo;
+        desc.dirty = false;
+    }
+    try {
+        file.writeRuns(*io, runs);
+    } catch (...) {
+        for (FrameId frameNo : written) {
+            bufDescTable[frameNo].dirty = true;
+        }
+        throw;
+    }
+    bufStats.diskwrites += written.size();
+    report.pages += written.size();
+    report.bytes += written.size() * Page::SIZE;
+    report.writes += runs.size();
+
+    // pins are taken under the hash latch, not the frame latch, so a page
+    // may have been pinned since it was checked; such a page is left
+    // resident, and reported once the rest of the file is dropped
+    FrameId pinnedFrame = numBufs;
+    for (FrameId frameNo : frames) {
+        BufDesc& desc = bufDescTable[frameNo];
+        {
+            std::lock_guard<std::mutex> guard(
+                hashTable.latch(file, desc.pageNo));
+            if (desc.pinCnt > 0) {
+                if (pinnedFrame == numBufs) {
+                    pinnedFrame = frameNo;
+                }
+                continue;
             }
-            hashTable.remove(bufDescTable[i].file, bufDescTable[i].pageNo);
-            bufDescTable[i].clear();
+            hashTable.remove(desc.file, desc.pageNo);
+            unindexFrame(desc.fileId, desc.pageNo);
         }
+        desc.clear();
+        leaveScanRing(frameNo);
+        policy->freed(frameNo);
+    }
+    file.flush();
+    if (pinnedFrame != numBufs) {
+        throw PagePinnedException(file.filename(),
+                                  bufDescTable[pinnedFrame].pageNo,
+                                  pinnedFrame);
     }
-    file.close();
+    report.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    return report;
 }
 
 /**
@@ -224,19 +840,413 @@ void BufMgr::flushFile(File& file) {
  */
 
 void BufMgr::disposePage(File& file, const PageId PageNo) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
     FrameId frameNo;
-    try {
-        hashTable.lookup(file, PageNo, frameNo);
-        hashTable.remove(file, PageNo);
-        bufDescTable[frameNo].clear();
-        file.deletePage(PageNo);
-    } catch (const HashNotFoundException &) {
-        file.deletePage(PageNo);
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(hashTable.latch(file, PageNo));
+            if (!hashTable.tryLookup(file, PageNo, frameNo)) {
+                break;
+            }
+        }
+        // the page may move to another frame before we latch this one; only
+        // clear the frame if it still holds the page afterwards
+        std::lock_guard<std::mutex> frameGuard(bufDescTable[frameNo].latch);
+        std::lock_guard<std::mutex> guard(hashTable.latch(file, PageNo));
+        FrameId currentFrameNo;
+        if (hashTable.tryLookup(file, PageNo, currentFrameNo) &&
+            currentFrameNo == frameNo) {
+            hashTable.remove(file, PageNo);
+            unindexFrame(file.id(), PageNo);
+            bufDescTable[frameNo].clear();
+            leaveScanRing(frameNo);
+            policy->freed(frameNo);
+            break;
+        }
+    }
+    file.deletePage(PageNo);
+}
+
+/**
+ * @brief Move a resident page to a free frame
+ *
+ * @param from frame holding the page
+ * @param to free frame
+ */
+void BufMgr::moveFrame(const FrameId from, const FrameId to) {
+    BufDesc& source = bufDescTable[from];
+    BufDesc& target = bufDescTable[to];
+    bufPool[to] = bufPool[from];
+    {
+        std::lock_guard<std::mutex> guard(
+            hashTable.latch(source.file, source.pageNo));
+        hashTable.remove(source.file, source.pageNo);
+        hashTable.insert(source.file, source.pageNo, to);
+        indexFrame(source.fileId, source.pageNo, to);
+    }
+    target.Set(source.file, source.pageNo);
+    target.pinCnt = 0;
+    target.dirty = source.dirty.load();
+    target.prefetched = source.prefetched.load();
+    // a page read by a scan stays first in line for eviction
+    const bool cold = leaveScanRing(from);
+    source.clear();
+    policy->freed(from);
+    if (cold) {
+        policy->loadedCold(to);
+    } else {
+        policy->loaded(to);
+    }
+}
+
+/**
+ * @brief grow or shrink the buffer pool
+ * @param bufs
+ */
+void BufMgr::resize(std::uint32_t bufs) {
+    bufs = std::max<std::uint32_t>(1, bufs);
+    std::unique_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    if (bufs < numBufs) {
+        // check every frame and write back every dirty page first, so a
+        // failed shrink changes nothing but which pages are clean
+        for (FrameId i = bufs; i < numBufs; i++) {
+            if (bufDescTable[i].pinCnt > 0) {
+                throw PagePinnedException(bufDescTable[i].file.filename(),
+                                          bufDescTable[i].pageNo, i);
+            }
+        }
+        // keep as many of the pages being cut off as there are free frames
+        // to hold them
+        FrameId freeFrame = 0;
+        for (FrameId i = bufs; i < numBufs; i++) {
+            if (!bufDescTable[i].valid) {
+                continue;
+            }
+            while (freeFrame < bufs && bufDescTable[freeFrame].valid) {
+                freeFrame++;
+            }
+            if (freeFrame == bufs) {
+                break;
+            }
+            moveFrame(i, freeFrame);
+        }
+        for (FrameId i = bufs; i < numBufs; i++) {
+            BufDesc& desc = bufDescTable[i];
+            std::lock_guard<std::mutex> frameGuard(desc.latch);
+            if (desc.valid && desc.dirty.exchange(false)) {
+                try {
+                    desc.file.writePage(bufPool[i]);
+                } catch (...) {
+                    desc.dirty = true;
+                    throw;
+                }
+                bufStats.diskwrites++;
+            }
+        }
+        // nothing can pin or dirty a page while the pool is latched
+        // exclusively, so the clean frames are simply unmapped; should one
+        // still refuse, the frames emptied so far stay in the pool unused
+        for (FrameId i = bufs; i < numBufs; i++) {
+            BufDesc& desc = bufDescTable[i];
+            std::lock_guard<std::mutex> frameGuard(desc.latch);
+            if (desc.valid && !evictFrame(desc)) {
+                throw PagePinnedException(desc.file.filename(), desc.pageNo,
+                                          i);
+            }
+            leaveScanRing(i);
+            policy->freed(i);
+        }
+        policy->resize(bufs);
+        while (bufDescTable.size() > bufs) {
+            bufDescTable.pop_back();
+        }
+        bufPool.resize(bufs);
+    } else {
+        bufPool.resize(bufs);
+        for (FrameId i = numBufs; i < bufs; i++) {
+            bufDescTable.emplace_back();
+            bufDescTable.back().frameNo = i;
+        }
+        policy->resize(bufs);
+    }
+    numBufs = bufs;
+    scanRingSize = std::max<std::uint32_t>(
+        1, std::min<std::uint32_t>(SCAN_RING_MAX, bufs / 8));
+}
+
+/**
+ * @brief queue pages to be read in the background
+ * @param file
+ * @param firstPage
+ * @param count
+ * @param hint
+ */
+void BufMgr::prefetch(File& file, const PageId firstPage,
+                      const std::uint32_t count, const AccessHint hint) {
+    if (count == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(prefetchLatch);
+    if (prefetchStopping) {
+        return;
+    }
+    prefetchQueue.push_back(PrefetchRequest{file, firstPage, count, hint});
+    if (!prefetcher.joinable()) {
+        prefetcher = std::thread(&BufMgr::prefetchLoop, this);
+    }
+    prefetchQueued.notify_one();
+}
+
+/**
+ * @brief block until the prefetch queue is drained
+ */
+void BufMgr::waitForPrefetch() {
+    std::unique_lock<std::mutex> lock(prefetchLatch);
+    prefetchDone.wait(lock, [this] {
+        return prefetchQueue.empty() && prefetchingFile == File::INVALID_ID;
+    });
+}
+
+/**
+ * @brief read queued runs until the buffer manager is destroyed
+ */
+void BufMgr::prefetchLoop() {
+    std::unique_lock<std::mutex> lock(prefetchLatch);
+    while (true) {
+        prefetchQueued.wait(lock, [this] {
+            return prefetchStopping || !prefetchQueue.empty();
+        });
+        if (prefetchStopping) {
+            return;
+        }
+        {
+            PrefetchRequest request = prefetchQueue.front();
+            prefetchQueue.pop_front();
+            prefetchingFile = request.file.id();
+            lock.unlock();
+            try {
+                prefetchRun(request);
+            } catch (const BadgerDbException&) {
+                // read-ahead is only advisory
+            } catch (...) {
+                // keep the thread alive for the rest of the queue
+                bufStats.backgrounderrors++;
+            }
+        }
+        lock.lock();
+        prefetchingFile = File::INVALID_ID;
+        prefetchDone.notify_all();
+    }
+}
+
+/**
+ * @brief read the missing pages of a queued run ahead, a batch of runs of
+ * consecutive missing pages at a time
+ * @param request
+ */
+void BufMgr::prefetchRun(PrefetchRequest& request) {
+    File& file = request.file;
+    // read-ahead is only advisory: stop at the end of the file, a page that
+    // cannot be read or a full buffer pool
+    const PageId numPages = file.readHeader().num_pages;
+    const PageId endPage = std::min<std::uint64_t>(
+        (std::uint64_t)request.firstPage + request.count, numPages);
+    PageId pageNo = request.firstPage;
+    while (pageNo < endPage) {
+        std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+        const PageId maxBatch = std::max<std::uint32_t>(1, numBufs / 4);
+        const PageId maxRun = std::min<std::uint32_t>(MAX_READ_RUN, maxBatch);
+        std::vector<FrameRun> runs;
+        std::vector<std::unique_lock<std::mutex>> frameGuards;
+        PageId batchPages = 0;
+        bool full = false;
+        for (; pageNo < endPage && batchPages < maxBatch; pageNo++) {
+            FrameId frameNo;
+            bool resident;
+            {
+                std::lock_guard<std::mutex> guard(
+                    hashTable.latch(file, pageNo));
+                resident = hashTable.tryLookup(file, pageNo, frameNo);
+            }
+            if (resident) {
+                continue;
+            }
+            try {
+                frameNo = claimFrame(request.hint);
+            } catch (const BadgerDbException&) {
+                full = true;
+                break;
+            }
+            frameGuards.emplace_back(bufDescTable[frameNo].latch,
+                                     std::adopt_lock);
+            if (runs.empty() ||
+                runs.back().firstPage + runs.back().frames.size() != pageNo ||
+                runs.back().frames.size() == maxRun) {
+                runs.push_back(FrameRun{&file, pageNo, {}});
+            }
+            runs.back().frames.push_back(frameNo);
+            batchPages++;
+        }
+        try {
+            readFrameRuns(runs);
+        } catch (...) {
+            for (const FrameRun& run : runs) {
+                for (FrameId frameNo : run.frames) {
+                    policy->freed(frameNo);
+                }
+            }
+            throw;
+        }
+        for (const FrameRun& run : runs) {
+            bufStats.prefetchreads += run.frames.size();
+            for (PageId i = 0; i < run.frames.size(); i++) {
+                installPage(file, run.firstPage + i, run.frames[i],
+                            request.hint, true);
+            }
+        }
+        if (full) {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief start the background writer, restarting it if running
+ * @param cleanTarget
+ * @param pagesPerSecond
+ */
+void BufMgr::startBackgroundWriter(const double cleanTarget,
+                                   const std::uint32_t pagesPerSecond) {
+    std::lock_guard<std::mutex> control(writerControlLatch);
+    joinWriter();
+    writerCleanTarget = std::min(1.0, std::max(0.0, cleanTarget));
+    writerRate = std::max<std::uint32_t>(1, pagesPerSecond);
+    {
+        std::lock_guard<std::mutex> guard(writerLatch);
+        writerStopping = false;
+    }
+    writer = std::thread(&BufMgr::writerLoop, this);
+}
+
+/**
+ * @brief stop the background writer
+ */
+void BufMgr::stopBackgroundWriter() {
+    std::lock_guard<std::mutex> control(writerControlLatch);
+    joinWriter();
+}
+
+/**
+ * @brief stop the background writer and wait for it to exit
+ */
+void BufMgr::joinWriter() {
+    {
+        std::lock_guard<std::mutex> guard(writerLatch);
+        writerStopping = true;
+    }
+    writerWake.notify_all();
+    if (writer.joinable()) {
+        writer.join();
+    }
+}
+
+/**
+ * @brief write back dirty frames beyond the clean target
+ * @param maxWrites
+ */
+void BufMgr::cleanFrames(const std::uint32_t maxWrites) {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    if (writerHand >= numBufs) {
+        writerHand = 0;
+    }
+    std::uint32_t dirtyFrames = 0;
+    for (FrameId i = 0; i < numBufs; i++) {
+        if (bufDescTable[i].dirty) {
+            dirtyFrames++;
+        }
+    }
+    const std::uint32_t allowed =
+        (std::uint32_t)(numBufs * (1 - writerCleanTarget));
+    if (dirtyFrames <= allowed) {
         return;
     }
+    const std::uint32_t toWrite = std::min(maxWrites, dirtyFrames - allowed);
+    std::vector<FrameId> frames;
+    std::vector<std::unique_lock<std::mutex>> frameGuards;
+    for (std::uint32_t i = 0; i < numBufs && frames.size() < toWrite; i++) {
+        BufDesc& desc = bufDescTable[writerHand];
+        writerHand = (writerHand + 1) % numBufs;
+        if (!desc.dirty || desc.pinCnt > 0) {
+            continue;
+        }
+        // never wait for a frame being evicted, loaded or flushed
+        std::unique_lock<std::mutex> frameGuard(desc.latch, std::try_to_lock);
+        if (!frameGuard.owns_lock()) {
+            continue;
+        }
+        // the page stays resident, so a write that races with a new pin just
+        // leaves the frame dirty again when it is unpinned
+        if (desc.valid && desc.dirty.exchange(false)) {
+            frames.push_back(desc.frameNo);
+            frameGuards.push_back(std::move(frameGuard));
+        }
+    }
+    // write each file's pages as runs of adjacent pages, all in flight at once
+    std::sort(frames.begin(), frames.end(), [this](FrameId a, FrameId b) {
+        return std::make_pair(bufDescTable[a].fileId, bufDescTable[a].pageNo) <
+               std::make_pair(bufDescTable[b].fileId, bufDescTable[b].pageNo);
+    });
+    std::size_t first = 0;
+    try {
+        while (first < frames.size()) {
+            File& file = bufDescTable[frames[first]].file;
+            std::vector<PageRun> runs;
+            std::size_t last = first;
+            for (; last < frames.size() &&
+                   bufDescTable[frames[last]].fileId == file.id();
+                 last++) {
+                const BufDesc& desc = bufDescTable[frames[last]];
+                if (last == first ||
+                    bufDescTable[frames[last - 1]].pageNo + 1 != desc.pageNo) {
+                    runs.push_back(PageRun{desc.pageNo, {}});
+                }
+                runs.back().pages.push_back(& bufPool[desc.frameNo]);
+            }
+            file.writeRuns(*io, runs);
+            bufStats.diskwrites += last - first;
+            bufStats.backgroundwrites += last - first;
+            first = last;
+        }
+    } catch (...) {
+        for (; first < frames.size(); first++) {
+            bufDescTable[frames[first]].dirty = true;
+        }
+        throw;
+    }
+}
+
+/**
+ * @brief clean frames in batches ten times a second until stopped
+ */
+void BufMgr::writerLoop() {
+    const std::chrono::milliseconds tick(100);
+    const std::uint32_t batch = std::max<std::uint32_t>(1, writerRate / 10);
+    std::unique_lock<std::mutex> lock(writerLatch);
+    while (!writerStopping) {
+        lock.unlock();
+        try {
+            cleanFrames(batch);
+        } catch (...) {
+            // the pages were left dirty; try again on the next tick
+            bufStats.backgrounderrors++;
+        }
+        lock.lock();
+        writerWake.wait_for(lock, tick, [this] { return writerStopping; });
+    }
 }
 
 void BufMgr::printSelf(void) {
+  std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
   int validFrames = 0;
 
   for (FrameId i = 0; i < numBufs; i++) {
@@ -8,11 +8,24 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include "bufHashTbl.h"
 #include "file.h"
+#include "frame_arena.h"
+#include "io_engine.h"
+#include "replacement_policy.h"
 
 namespace badgerdb {
 
@@ -23,21 +36,32 @@ class BufMgr;
 
 /**
  * @brief Class for maintaining information about buffer pool frames
+ *
+ * pinCnt is only changed while holding the hash table latch of the frame's
+ * page, so a frame seen unpinned under that latch cannot be pinned until the
+ * latch is released.  file, pageNo and valid are only changed by the thread
+ * holding the frame's latch.
  */
 class BufDesc {
  public:
   /**
    * Constructor of BufDesc class
    */
-  BufDesc() { clear(); }
+  BufDesc() : inScanRing(false) { clear(); }
 
  private:
   friend class BufMgr;
+  friend class ClockPolicy;
   /**
    * Pointer to file to which corresponding frame is assigned
    */
   File file;
 
+  /**
+   * Id of file, so frames can be matched to a file with an integer compare
+   */
+  FileId fileId;
+
   /**
    * Page within file to which corresponding frame is assigned
    */
@@ -51,12 +75,12 @@ class BufDesc {
   /**
    * Number of times this page has been pinned
    */
-  int pinCnt;
+  std::atomic<int> pinCnt;
 
   /**
    * True if page is dirty;  false otherwise
    */
-  bool dirty;
+  std::atomic<bool> dirty;
 
   /**
    * True if page is valid
@@ -64,9 +88,25 @@ class BufDesc {
   bool valid;
 
   /**
-   * Has this buffer frame been reference recently
+   * Has this buffer frame been reference recently (used by ClockPolicy)
+   */
+  std::atomic<bool> refbit;
+
+  /**
+   * Held while the frame is being evicted, loaded or flushed
+   */
+  std::mutex latch;
+
+  /**
+   * True while the frame belongs to the scan ring; changed only under the
+   * scan ring latch
    */
-  bool refbit;
+  std::atomic<bool> inScanRing;
+
+  /**
+   * True if the page was read ahead and has not been asked for since
+   */
+  std::atomic<bool> prefetched;
 
   /**
    * Initialize buffer frame for a new user
@@ -74,10 +114,12 @@ class BufDesc {
   void clear() {
     pinCnt = 0;
     file = File();
+    fileId = File::INVALID_ID;
     pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
     valid = false;
+    prefetched = false;
   }
 
   /**
@@ -90,6 +132,7 @@ class BufDesc {
    */
   void Set(File& file, PageId pageNum) {
     this->file = file;
+    fileId = file.id();
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
@@ -100,6 +143,7 @@ class BufDesc {
   void Print() {
     if (file.isValid()) {
       std::cout << "file:" << file.filename() << " ";
+      std::cout << "fileId:" << fileId << " ";
       std::cout << "pageNo:" << pageNo << " ";
     } else
       std::cout << "file:NULL ";
@@ -118,22 +162,50 @@ struct BufStats {
   /**
    * Total number of accesses to buffer pool
    */
-  int accesses;
+  std::atomic<int> accesses;
+
+  /**
+   * Number of pages read from disk, not counting pages read ahead or
+   * allocated
+   */
+  std::atomic<int> diskreads;
+
+  /**
+   * Number of pages written back by the background writer, also counted in
+   * diskwrites
+   */
+  std::atomic<int> backgroundwrites;
 
   /**
-   * Number of pages read from disk (including allocs)
+   * Number of pages read from disk ahead of being asked for
    */
-  int diskreads;
+  std::atomic<int> prefetchreads;
+
+  /**
+   * Number of accesses served by a page that was read ahead
+   */
+  std::atomic<int> prefetchhits;
 
   /**
    * Number of pages written back to disk
    */
-  int diskwrites;
+  std::atomic<int> diskwrites;
+
+  /**
+   * Number of failures the background writer and read-ahead threads caught
+   * and carried on from: failed background writes, and read-ahead errors
+   * other than running into the end of the file, a deleted page or a full
+   * buffer pool
+   */
+  std::atomic<int> backgrounderrors;
 
   /**
    * Clear all values
    */
-  void clear() { accesses = diskreads = diskwrites = 0; }
+  void clear() {
+    accesses = diskreads = diskwrites = backgroundwrites = prefetchreads =
+        prefetchhits = backgrounderrors = 0;
+  }
 
   /**
    * Constructor of BufStats class
@@ -141,17 +213,146 @@ struct BufStats {
   BufStats() { clear(); }
 };
 
+/**
+ * @brief How the caller of BufMgr::readPage expects to use the page
+ */
+enum class AccessHint {
+  /**
+   * Ordinary access; the replacement policy decides how long the page stays.
+   */
+  RANDOM,
+
+  /**
+   * Part of a one-pass sequential scan.  Pages read under this hint are
+   * recycled from a small ring of frames so the scan never displaces the
+   * rest of the buffer pool.
+   */
+  SEQUENTIAL,
+
+  /**
+   * Not expected to be needed again.  The page is loaded first in eviction
+   * order and hits do not count as recent use.
+   */
+  ONE_SHOT
+};
+
+/**
+ * @brief A run of pages queued for reading ahead
+ */
+struct PrefetchRequest {
+  /**
+   * File to read from; the copy keeps it open until the request is done
+   */
+  File file;
+
+  /**
+   * First page of the run
+   */
+  PageId firstPage;
+
+  /**
+   * Number of pages in the run
+   */
+  std::uint32_t count;
+
+  /**
+   * Hint the pages are loaded with
+   */
+  AccessHint hint;
+};
+
+/**
+ * @brief A run of consecutive pages of a file being read into claimed frames
+ */
+struct FrameRun {
+  /**
+   * File to read from
+   */
+  File* file;
+
+  /**
+   * First page of the run
+   */
+  PageId firstPage;
+
+  /**
+   * Latched frames to read the pages into, in page order
+   */
+  std::vector<FrameId> frames;
+};
+
+/**
+ * @brief What BufMgr::flushFile wrote back
+ */
+struct FlushReport {
+  /**
+   * Number of dirty pages written back
+   */
+  std::uint32_t pages;
+
+  /**
+   * Number of bytes written back
+   */
+  std::uint64_t bytes;
+
+  /**
+   * Number of vectored writes, one per run of adjacent dirty pages
+   */
+  std::uint32_t writes;
+
+  /**
+   * Time taken by the flush, including the final sync
+   */
+  std::chrono::microseconds elapsed;
+};
+
+/**
+ * @brief One page of a BufMgr::readPages batch
+ */
+struct PageRequest {
+  /**
+   * File the page belongs to
+   */
+  File* file;
+
+  /**
+   * Page number in the file
+   */
+  PageId pageNo;
+
+  /**
+   * Set by readPages to the pinned page
+   */
+  Page* page;
+};
+
+/**
+ * @brief Position of the sequential read-ahead in one file
+ */
+struct ReadAheadState {
+  /**
+   * Page most recently asked for
+   */
+  PageId lastPage;
+
+  /**
+   * Last page already queued for reading ahead
+   */
+  PageId prefetchedThrough;
+};
+
 /**
  * @brief The central class which manages the buffer pool including frame
  * allocation and deallocation to pages in the file
+ *
+ * All public methods may be called concurrently.  Lookups and pins are
+ * serialized only per hash table latch, and victims are claimed with
+ * try-locks, so threads working on different pages rarely wait on each
+ * other.  Which frame is evicted is decided by a ReplacementPolicy chosen at
+ * construction.
  */
 class BufMgr {
  private:
-  /**
-   * Current position of clockhand in our buffer pool
-   */
-  FrameId clockHand;
-
   /**
    * Number of frames in the buffer pool
    */
@@ -162,11 +363,29 @@ class BufMgr {
    */
   BufHashTbl hashTable;
 
+  /**
+   * Resident pages of each file and the frames holding them, so a file's
+   * frames can be found without sweeping the whole pool
+   */
+  std::unordered_map<FileId, std::map<PageId, FrameId>> fileFrames;
+
+  /**
+   * Protects fileFrames.  Taken while holding a hash table latch.
+   */
+  std::mutex fileFramesLatch;
+
   /**
    * Array of BufDesc objects to hold information corresponding to every frame
-   * allocation from 'bufPool' (the buffer pool)
+   * allocation from 'bufPool' (the buffer pool).  A deque, so the pool can
+   * grow and shrink without moving descriptors.
+   */
+  std::deque<BufDesc> bufDescTable;
+
+  /**
+   * Held shared by every operation and exclusively by resize(), so frames
+   * never disappear under an operation
    */
-  std::vector<BufDesc> bufDescTable;
+  std::shared_mutex resizeLatch;
 
   /**
    * Maintains Buffer pool usage statistics
@@ -174,12 +393,136 @@ class BufMgr {
   BufStats bufStats;
 
   /**
-   * Advance clock to next frame in the buffer pool
+   * Most pages readPages() reads with a single read
+   */
+  static constexpr std::uint32_t MAX_READ_RUN = 32;
+
+  /**
+   * Most frames the scan ring may hold
+   */
+  static constexpr std::uint32_t SCAN_RING_MAX = 32;
+
+  /**
+   * Number of frames the scan ring holds once full
+   */
+  std::uint32_t scanRingSize;
+
+  /**
+   * Frames holding pages read under AccessHint::SEQUENTIAL, oldest first.
+   * They are owned by the ring rather than the replacement policy.
    */
-  void advanceClock();
+  std::deque<FrameId> scanRing;
 
   /**
-   * Allocate a free frame.
+   * Protects scanRing.  Frame latches are only try-locked while holding it.
+   */
+  std::mutex scanRingLatch;
+
+  /**
+   * Pages read ahead once sequential access to a file is seen; 0 disables
+   */
+  std::atomic<std::uint32_t> readAheadPages;
+
+  /**
+   * Read-ahead position of each file read sequentially
+   */
+  std::unordered_map<FileId, ReadAheadState> readAhead;
+
+  /**
+   * Protects readAhead
+   */
+  std::mutex readAheadLatch;
+
+  /**
+   * Runs queued for the prefetch thread, oldest first
+   */
+  std::deque<PrefetchRequest> prefetchQueue;
+
+  /**
+   * File of the run the prefetch thread is reading, or File::INVALID_ID
+   */
+  FileId prefetchingFile;
+
+  /**
+   * Set to stop the prefetch thread
+   */
+  bool prefetchStopping;
+
+  /**
+   * Protects prefetchQueue, prefetchingFile and prefetchStopping
+   */
+  std::mutex prefetchLatch;
+
+  /**
+   * Signalled when a run is queued or the thread is stopped
+   */
+  std::condition_variable prefetchQueued;
+
+  /**
+   * Signalled when the prefetch thread finishes a run
+   */
+  std::condition_variable prefetchDone;
+
+  /**
+   * Reads queued runs; started by the first prefetch
+   */
+  std::thread prefetcher;
+
+  /**
+   * Fraction of frames the background writer keeps clean
+   */
+  double writerCleanTarget;
+
+  /**
+   * Most pages the background writer writes per second
+   */
+  std::uint32_t writerRate;
+
+  /**
+   * Next frame the background writer looks at; used by that thread only
+   */
+  FrameId writerHand;
+
+  /**
+   * Set to stop the background writer
+   */
+  bool writerStopping;
+
+  /**
+   * Protects writerStopping
+   */
+  std::mutex writerLatch;
+
+  /**
+   * Signalled when the background writer is stopped
+   */
+  std::condition_variable writerWake;
+
+  /**
+   * Writes dirty unpinned frames back ahead of eviction, when started
+   */
+  std::thread writer;
+
+  /**
+   * Held across startBackgroundWriter() and stopBackgroundWriter(), so that
+   * concurrent calls do not both join or both assign writer
+   */
+  std::mutex writerControlLatch;
+
+  /**
+   * Decides which frame to evict
+   */
+  std::unique_ptr<ReplacementPolicy> policy;
+
+  /**
+   * Carries out batched reads and writes, several at a time
+   */
+  std::unique_ptr<IoEngine> io;
+
+  /**
+   * Allocate a free frame.  The frame is returned invalid, with its latch
+   * held by the caller, who must either Set() it or leave it invalid before
+   * releasing the latch.
    *
    * @param frame   	Frame reference, frame ID of allocated frame returned
    * via this variable
@@ -188,16 +531,219 @@ class BufMgr {
    */
   void allocBuf(FrameId& frame);
 
+  /**
+   * Writes back the page in a valid, unpinned frame if dirty and removes it
+   * from the hash table.  The caller must hold the frame's latch.
+   *
+   * @param desc  Descriptor of the frame to evict
+   * @return  False if the page was pinned or dirtied again meanwhile, in which
+   * case the frame is left untouched
+   */
+  bool evictFrame(BufDesc& desc);
+
+  /**
+   * Adds a resident page to fileFrames.  The caller must hold the page's
+   * hash table latch.
+   *
+   * @param fileId  File the page belongs to
+   * @param pageNo  Page number in the file
+   * @param frame   Frame holding the page
+   */
+  void indexFrame(const FileId fileId, const PageId pageNo,
+                  const FrameId frame);
+
+  /**
+   * Removes a page from fileFrames.  The caller must hold the page's hash
+   * table latch.
+   *
+   * @param fileId  File the page belongs to
+   * @param pageNo  Page number in the file
+   */
+  void unindexFrame(const FileId fileId, const PageId pageNo);
+
+  /**
+   * Moves the page in a valid, unpinned frame into a free frame, keeping it
+   * resident and dirty if it was.  Only called by resize(), which holds
+   * resizeLatch exclusively.
+   *
+   * @param from  Frame holding the page
+   * @param to    Free frame to move it to
+   */
+  void moveFrame(const FrameId from, const FrameId to);
+
+  /**
+   * Reuses the oldest claimable frame of the scan ring, once the ring is full.
+   * The frame is returned invalid with its latch held, as from allocBuf().
+   *
+   * @param frame   Frame ID of the reused frame returned via this variable
+   * @return  False if the ring is not full or none of its frames is free
+   */
+  bool allocScanBuf(FrameId& frame);
+
+  /**
+   * Adds a frame just loaded under AccessHint::SEQUENTIAL to the scan ring.
+   *
+   * @param frame   Frame to add
+   * @return  False if the ring is full
+   */
+  bool joinScanRing(const FrameId frame);
+
+  /**
+   * Removes a frame from the scan ring if it is in it.
+   *
+   * @param frame   Frame to remove
+   * @return  True if the frame was in the ring
+   */
+  bool leaveScanRing(const FrameId frame);
+
+  /**
+   * Body of unPinPage(), for callers already holding the resize latch.
+   *
+   * @param file    File object
+   * @param pageNo  Page number
+   * @param dirty   True if the page needs to be marked dirty
+   * @throws  PageNotPinnedException If the page is not already pinned
+   */
+  void unPin(File& file, const PageId pageNo, const bool dirty);
+
+  /**
+   * Counts an access to a resident page and tells the replacement policy
+   * about it, unless the hint asks not to.
+   *
+   * @param frame   Frame holding the page
+   * @param hint    Hint the page was asked for with
+   */
+  void noteAccess(const FrameId frame, const AccessHint hint);
+
+  /**
+   * Claims a frame to load a page into, from the scan ring if the hint is
+   * SEQUENTIAL.  The frame is returned invalid with its latch held, as from
+   * allocBuf().
+   *
+   * @param hint    How the page will be used
+   * @return  Claimed frame
+   */
+  FrameId claimFrame(const AccessHint hint);
+
+  /**
+   * Maps a page just read into a claimed, latched frame.  If another thread
+   * loaded the page meanwhile, its frame is used instead and ours is freed.
+   *
+   * @param file      File object
+   * @param pageNo    Page number in the file
+   * @param frameNo   Frame the page was read into
+   * @param hint      How the page will be used
+   * @param prefetch  True to leave the page unpinned and count it as read
+   * ahead; otherwise it is pinned for the caller
+   * @return  Frame holding the page
+   */
+  FrameId installPage(File& file, const PageId pageNo, const FrameId frameNo,
+                      const AccessHint hint, const bool prefetch);
+
+  /**
+   * Reads a page that is not in the buffer pool into a frame.  If another
+   * thread loads the page meanwhile, its frame is used instead.
+   *
+   * @param file      File object
+   * @param pageNo    Page number in the file to be read
+   * @param hint      How the page will be used
+   * @param prefetch  True to leave the page unpinned and count it as read
+   * ahead; otherwise it is pinned for the caller
+   * @return  Frame holding the page
+   */
+  FrameId loadPage(File& file, const PageId pageNo, const AccessHint hint,
+                   const bool prefetch);
+
+  /**
+   * Reads runs of consecutive pages missing from the buffer pool, each with
+   * a single read and all of them in flight at once, and pins them for the
+   * requests.
+   *
+   * @param runs  Requests for each run, sorted by page number; a page may be
+   * requested more than once
+   * @param hint  How the pages will be used
+   */
+  void readRuns(const std::vector<std::vector<PageRequest*>>& runs,
+                const AccessHint hint);
+
+  /**
+   * Reads runs into their frames with all of the reads in flight at once.
+   * Every read has finished when this returns or throws; the frames are
+   * left to the caller either way.
+   *
+   * @param runs  Runs to read
+   * @throws InvalidPageException If a page does not exist in its file
+   */
+  void readFrameRuns(const std::vector<FrameRun>& runs);
+
+  /**
+   * Reads the missing pages of a queued run ahead, stopping at the end of
+   * the file, a page that cannot be read or a full buffer pool.
+   *
+   * @param request Run to read
+   * @throws  The exception of a page that cannot be read, after releasing
+   * the frames claimed for its batch
+   */
+  void prefetchRun(PrefetchRequest& request);
+
+  /**
+   * Queues the pages following pageNo for reading ahead once file is seen
+   * being read sequentially.
+   *
+   * @param file    File object
+   * @param pageNo  Page number just asked for
+   * @param hint    Hint the page was asked for with
+   */
+  void noteSequential(File& file, const PageId pageNo, const AccessHint hint);
+
+  /**
+   * Body of the prefetch thread.
+   */
+  void prefetchLoop();
+
+  /**
+   * Writes back up to maxWrites dirty, unpinned frames if more than the
+   * clean target allows are dirty.  Frames being used by another thread are
+   * skipped.
+   *
+   * @param maxWrites Most pages to write
+   */
+  void cleanFrames(const std::uint32_t maxWrites);
+
+  /**
+   * Body of the background writer thread.
+   */
+  void writerLoop();
+
+  /**
+   * Stops the background writer, if running.  Caller holds
+   * writerControlLatch.
+   */
+  void joinWriter();
+
  public:
   /**
    * Actual buffer pool from which frames are allocated
    */
-  std::vector<Page> bufPool;
+  FrameArena bufPool;
 
   /**
    * Constructor of BufMgr class
+   *
+   * @param bufs         Number of frames in the buffer pool
+   * @param replacement  Replacement algorithm to use
+   * @param memory       How to allocate the frames
+   * @param ioEngine     Engine for batched reads and writes
    */
-  BufMgr(std::uint32_t bufs);
+  BufMgr(std::uint32_t bufs, Replacement replacement = Replacement::CLOCK,
+         const PoolMemory& memory = PoolMemory(),
+         const IoEngineKind ioEngine = IoEngineKind::IO_URING);
+
+  /**
+   * Destructor of BufMgr class.  Stops the background writer and the
+   * prefetch thread; queued runs are dropped.
+   */
+  ~BufMgr();
 
   /**
    * Reads the given page from the file into a frame and returns the pointer to
@@ -209,8 +755,36 @@ class BufMgr {
    * @param PageNo  Page number in the file to be read
    * @param page  	Reference to page pointer. Used to fetch the Page object
    * in which requested page from file is read in.
+   * @param hint    How the caller will use the page
+   */
+  void readPage(File& file, const PageId pageNo, Page*& page,
+                const AccessHint hint = AccessHint::RANDOM);
+
+  /**
+   * Reads and pins a batch of pages, like calling readPage() for each.  Pages
+   * missing from the buffer pool are sorted and consecutive pages of a file
+   * are read with a single read, with the reads of several runs in flight
+   * at once.  If any page cannot be read, none of the
+   * batch is left pinned.
+   *
+   * @param requests  Pages to read; the page of each is set to the pinned
+   * page.  A page may be requested more than once and is pinned once per
+   * request.
+   * @param hint      How the caller will use the pages
+   * @throws InvalidPageException If a page does not exist in its file
+   * @throws BufferExceededException If not enough frames are free
+   */
+  void readPages(std::vector<PageRequest>& requests,
+                 const AccessHint hint = AccessHint::RANDOM);
+
+  /**
+   * Unpins a batch of pages, like calling unPinPage() for each.
+   *
+   * @param requests  Pages to unpin
+   * @param dirty     True if the pages need to be marked dirty
+   * @throws  PageNotPinnedException If a page is not already pinned
    */
-  void readPage(File& file, const PageId pageNo, Page*& page);
+  void unPinPages(const std::vector<PageRequest>& requests, const bool dirty);
 
   /**
    * Unpin a page from memory since it is no longer required for it to remain in
@@ -237,17 +811,24 @@ class BufMgr {
   void allocPage(File& file, PageId& pageNo, Page*& page);
 
   /**
-   * Writes out all dirty pages of the file to disk.
+   * Writes out all dirty pages of the file to disk and drops the file's pages
+   * from the buffer pool.  Dirty pages are written in page number order, each
+   * run of adjacent pages with one vectored write, followed by a single flush
+   * of the file.
    * All the frames assigned to the file need to be unpinned from buffer pool
    * before this function can be successfully called. Otherwise Error returned.
    *
    * @param file   	File object
+   * @return  Pages and bytes written, number of writes and time taken
    * @throws  PagePinnedException If any page of the file is pinned in the
-   * buffer pool
+   * buffer pool.  If it is found pinned before anything is written, nothing
+   * changes.  A page pinned by another thread while the flush is under way
+   * is written back but stays resident; the rest of the file is still
+   * dropped and flushed before the exception is thrown.
    * @throws BadBufferException If any frame allocated to the file is found to
    * be invalid
    */
-  void flushFile(File& file);
+  FlushReport flushFile(File& file);
 
   /**
    * Delete page from file and also from buffer pool if present.
@@ -259,11 +840,88 @@ class BufMgr {
    */
   void disposePage(File& file, const PageId PageNo);
 
+  /**
+   * Grows or shrinks the buffer pool while it stays in use.  Growing adds
+   * empty frames.  Shrinking removes the frames at the end of the pool: the
+   * pages they hold move into free frames that stay, and those that do not
+   * fit are written back and dropped; the hash table adapts on its own.
+   * Waits for operations in progress to finish.
+   *
+   * A pinned page cannot move, as its caller holds a pointer into the frame,
+   * so a pin in a frame to be removed fails the shrink however many frames
+   * below the new size are free.  Pins below it do not matter.
+   *
+   * @param bufs  New number of frames, at least 1
+   * @throws  PagePinnedException If a frame to be removed is pinned, in
+   * which case the pool is left unchanged
+   * @throws  FileIOException If a page cannot be written back, in which case
+   * the pool keeps its size, with that page dirty and the pages moved so far
+   * in their new frames
+   */
+  void resize(std::uint32_t bufs);
+
+  /**
+   * Returns the number of frames in the buffer pool.
+   */
+  std::uint32_t size() {
+    std::shared_lock<std::shared_mutex> resizeGuard(resizeLatch);
+    return numBufs;
+  }
+
+  /**
+   * Queues pages to be read into the buffer pool in the background, so a
+   * later readPage() of them does not wait for the disk.  Pages already in
+   * the pool are skipped, and the run stops at the first page that cannot
+   * be read or find a free frame.
+   *
+   * @param file   	File object
+   * @param firstPage  First page number of the run
+   * @param count   Number of pages in the run
+   * @param hint    How the pages will be used once read
+   */
+  void prefetch(File& file, const PageId firstPage, const std::uint32_t count,
+                const AccessHint hint = AccessHint::RANDOM);
+
+  /**
+   * Blocks until all queued prefetches have been read.
+   */
+  void waitForPrefetch();
+
+  /**
+   * Starts a thread that writes dirty, unpinned pages back in the background
+   * so that frames are usually clean by the time they are evicted.  Restarts
+   * the thread if already running.
+   *
+   * @param cleanTarget     Fraction of the frames to keep clean, from 0 to 1
+   * @param pagesPerSecond  Most pages to write per second
+   */
+  void startBackgroundWriter(const double cleanTarget,
+                             const std::uint32_t pagesPerSecond);
+
+  /**
+   * Stops the background writer, if running.
+   */
+  void stopBackgroundWriter();
+
+  /**
+   * Sets how far ahead readPage() reads once it sees a file being read page
+   * after page.  Read-ahead is off (0) by default.
+   *
+   * @param pages   Number of pages to keep read ahead; 0 disables
+   */
+  void setReadAhead(const std::uint32_t pages) { readAheadPages = pages; }
+
   /**
    * Print member variable values.
    */
   void printSelf();
 
+  /**
+   * Returns the I/O engine in use, which may differ from the one asked for
+   * if the kernel does not offer it.
+   */
+  IoEngineKind getIoEngineKind() const { return io->kind(); }
+
   /**
    * Get buffer pool usage statistics
    */
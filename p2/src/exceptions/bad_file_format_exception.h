@@ -0,0 +1,44 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file's header is corrupt or
+ *        describes a format this build cannot read.
+ */
+class BadFileFormatException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad file format exception for the given file.
+   *
+   * @param name    Name of file whose header was rejected.
+   * @param reason  What is wrong with the header.
+   */
+  explicit BadFileFormatException(const std::string &name,
+                                  const std::string &reason);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+};
+
+}  // namespace badgerdb
@@ -0,0 +1,48 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system reports an
+ *        error reading from or writing to a file.
+ */
+class FileIOException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given file.
+   *
+   * @param name      Name of file the operation failed on.
+   * @param errorNum  errno value reported for the failure.
+   */
+  explicit FileIOException(const std::string &name, int errorNum);
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string &filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * errno value reported for the failure.
+   */
+  const int errorNum_;
+};
+
+}  // namespace badgerdb
@@ -8,31 +8,139 @@
 
 #include "file.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <string>
+#include <vector>
 
+#include "exceptions/bad_file_format_exception.h"
 #include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/read_only_file_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
+namespace {
+
+/**
+ * Frees memory from std::aligned_alloc().
+ */
+struct FreeDeleter {
+  void operator()(char *memory) const { std::free(memory); }
+};
+
+typedef std::unique_ptr<char, FreeDeleter> AlignedBuffer;
+
+/**
+ * Allocates a buffer suitable for O_DIRECT transfers.
+ *
+ * @param length  Size of the buffer, a multiple of File::DIRECT_ALIGNMENT.
+ * @throws  std::bad_alloc  If the memory cannot be allocated.
+ */
+AlignedBuffer allocateAligned(const std::size_t length) {
+  void *memory = std::aligned_alloc(File::DIRECT_ALIGNMENT, length);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return AlignedBuffer(static_cast<char *>(memory));
+}
+
+/**
+ * Computes the CRC-32 (IEEE 802.3) of a buffer.
+ */
+std::uint32_t crc32(const char *data, const std::size_t length) {
+  std::uint32_t crc = 0xFFFFFFFF;
+  for (std::size_t i = 0; i < length; ++i) {
+    crc ^= static_cast<unsigned char>(data[i]);
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+/**
+ * Rounds a file position down to a multiple of File::DIRECT_ALIGNMENT.
+ */
+std::streamoff alignDown(const std::streamoff position) {
+  return position - position % File::DIRECT_ALIGNMENT;
+}
+
+/**
+ * Rounds a file position up to a multiple of File::DIRECT_ALIGNMENT.
+ */
+std::streamoff alignUp(const std::streamoff position) {
+  return alignDown(position + File::DIRECT_ALIGNMENT - 1);
+}
+
+/**
+ * Applies madvise() advice to the pages of a mapping covering a range of
+ * its bytes, clipped to the mapping.  Advice is only a hint, so failures
+ * are ignored.
+ */
+void adviseRange(const char *mapping, const std::size_t mapping_length,
+                 const std::size_t position, std::size_t length,
+                 const int advice) {
+  if (position >= mapping_length) {
+    return;
+  }
+  length = std::min(length, mapping_length - position);
+  const std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+  const std::size_t start = position - position % page_size;
+  ::madvise(const_cast<char *>(mapping) + start, position + length - start,
+            advice);
+}
+
+}  // namespace
+
 File::StreamMap File::open_streams_;
 File::CountMap File::open_counts_;
+FileId File::next_id_ = File::INVALID_ID + 1;
+std::mutex File::open_files_latch_;
 
-File File::create(const std::string &filename) {
-  return File(filename, true /* create_new */);
+FileStream::~FileStream() {
+  if (mapping != nullptr) {
+    ::munmap(const_cast<char *>(mapping), mapping_length);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+File File::create(const std::string &filename, const FileBackend backend,
+                  const FileFormat format) {
+  if (backend == FileBackend::MMAP) {
+    throw ReadOnlyFileException(filename);
+  }
+  return File(filename, true /* create_new */, backend, format);
 }
 
-File File::open(const std::string &filename) {
-  return File(filename, false /* create_new */);
+File File::open(const std::string &filename, const FileBackend backend) {
+  return File(filename, false /* create_new */, backend);
 }
 
 void File::remove(const std::string &filename) {
@@ -45,10 +153,48 @@ void File::remove(const std::string &filename) {
   std::remove(filename.c_str());
 }
 
+void File::convert(const std::string &filename, const FileFormat format) {
+  if (!exists(filename)) {
+    throw FileNotFoundException(filename);
+  }
+  if (isOpen(filename)) {
+    throw FileOpenException(filename);
+  }
+  const std::string converted = filename + ".convert";
+  {
+    File source = File::open(filename);
+    // Converting a file to its own format upgrades an older version.
+    if (source.format() == format &&
+        (format == FileFormat::LEGACY ||
+         source.formatVersion() == FormatHeader::VERSION)) {
+      return;
+    }
+    // Left over from a conversion that did not finish.
+    std::remove(converted.c_str());
+    File target = File::create(converted, FileBackend::POSIX, format);
+    // Pages are copied whole, free ones included, so page numbers, the used
+    // and free lists and the header all carry over unchanged.
+    const FileHeader header = source.readHeader();
+    for (PageId page_number = 1; page_number < header.num_pages;
+         ++page_number) {
+      target.writePage(page_number,
+                       source.readPage(page_number, true /* allow_free */));
+    }
+    target.writeHeader(header);
+    std::lock_guard<std::recursive_mutex> guard(target.stream_->latch);
+    target.writeBackHeader();
+    target.sync();
+  }
+  if (std::rename(converted.c_str(), filename.c_str()) != 0) {
+    throw FileIOException(filename, errno);
+  }
+}
+
 bool File::isOpen(const std::string &filename) {
   if (!exists(filename)) {
     return false;
   }
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   return open_counts_.find(filename) != open_counts_.end();
 }
 
@@ -63,10 +209,13 @@ bool File::exists(const std::string &filename) {
 }
 
 File::File(const File &other)
-    : filename_(other.filename_),
-      stream_(open_streams_[filename_]),
-      valid_(other.valid_) {
-  ++open_counts_[filename_];
+    : filename_(other.filename_), id_(INVALID_ID), valid_(other.valid_) {
+  if (other.stream_) {
+    std::lock_guard<std::mutex> guard(open_files_latch_);
+    stream_ = other.stream_;
+    id_ = stream_->id;
+    ++open_counts_[filename_];
+  }
 }
 
 File &File::operator=(const File &rhs) {
@@ -75,13 +224,16 @@ File &File::operator=(const File &rhs) {
   close();  // close my file and associate me with the new one
   filename_ = rhs.filename_;
   valid_ = rhs.valid_;
-  openIfNeeded(false /* create_new */);
+  if (rhs.stream_) {
+    openIfNeeded(false /* create_new */, rhs.stream_->backend);
+  }
   return *this;
 }
 
-File::~File() { close(); }
+File::~File() { closeQuietly(); }
 
 Page File::allocatePage() {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
   FileHeader header = readHeader();
   Page new_page;
   Page existing_page;
@@ -148,26 +300,112 @@ Page File::allocatePage() {
 }
 
 Page File::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
-  if (page_number >= header.num_pages) {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void File::readPage(const PageId page_number, Page &page) const {
+  // Page 0 is never a page: it holds the header of either layout.
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= readHeader().num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  readBytes(pagePosition(page_number), reinterpret_cast<char *>(&page),
+            Page::SIZE);
+  if (!page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-  return readPage(page_number, false /* allow_free */);
+  pageFromDisk(page);
+}
+
+void File::readPages(const PageId first_page_number,
+                     const std::vector<Page *> &pages) const {
+  if (pages.empty()) {
+    return;
+  }
+  if (first_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(first_page_number, filename_);
+  }
+  const PageId last_page_number = first_page_number + pages.size() - 1;
+  if (last_page_number >= readHeader().num_pages) {
+    throw InvalidPageException(last_page_number, filename_);
+  }
+  std::vector<iovec> buffers;
+  for (Page *page : pages) {
+    buffers.push_back({page, Page::SIZE});
+  }
+  readVector(pagePosition(first_page_number), buffers);
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    pageFromDisk(*pages[i]);
+  }
+}
+
+void File::startReadPages(IoEngine &engine, IoBatch &batch,
+                          IoRequest &request, const PageId first_page_number,
+                          const std::vector<Page *> &pages) const {
+  request.buffers.clear();
+  if (pages.empty()) {
+    return;
+  }
+  if (first_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(first_page_number, filename_);
+  }
+  const PageId last_page_number = first_page_number + pages.size() - 1;
+  if (last_page_number >= readHeader().num_pages) {
+    throw InvalidPageException(last_page_number, filename_);
+  }
+  for (Page *page : pages) {
+    request.buffers.push_back({page, Page::SIZE});
+  }
+  if (stream_->backend == FileBackend::STREAM ||
+      stream_->backend == FileBackend::MMAP ||
+      (stream_->backend == FileBackend::DIRECT &&
+       !isDirectAligned(pagePosition(first_page_number), request.buffers))) {
+    readVector(pagePosition(first_page_number), request.buffers);
+    request.error = 0;
+    return;
+  }
+  request.op = IoOp::READ;
+  request.fd = stream_->fd;
+  request.offset = pagePosition(first_page_number);
+  engine.submit({&request}, batch);
+}
+
+void File::finishReadPages(const IoRequest &request,
+                           const PageId first_page_number,
+                           const std::vector<Page *> &pages) const {
+  if (request.error != 0) {
+    throw FileIOException(filename_, request.error);
+  }
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    if (!pages[i]->isUsed()) {
+      throw InvalidPageException(first_page_number + i, filename_);
+    }
+    pageFromDisk(*pages[i]);
+  }
 }
 
 Page File::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&page.header_), sizeof(page.header_));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
+  readBytes(pagePosition(page_number), reinterpret_cast<char *>(&page),
+            Page::SIZE);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
+  pageFromDisk(page);
 
   return page;
 }
 
 void File::writePage(const Page &new_page) {
+  if (new_page.page_number() == Page::INVALID_NUMBER) {
+    throw InvalidPageException(new_page.page_number(), filename_);
+  }
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
   PageHeader header = readPageHeader(new_page.page_number());
   if (header.current_page_number == Page::INVALID_NUMBER) {
     // Page has been deleted since it was read.
@@ -177,12 +415,146 @@ void File::writePage(const Page &new_page) {
   // we don't modify that, but we do keep all the other modifications to the
   // page header.
   const PageId next_page_number = header.next_page_number;
-  header = new_page.header_;
+  header = headerToDisk(new_page.header_);
   header.next_page_number = next_page_number;
   writePage(new_page.page_number(), header, new_page);
 }
 
+void File::writePages(const PageId first_page_number,
+                      const std::vector<const Page *> &pages) {
+  if (pages.empty()) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  if (first_page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(first_page_number, filename_);
+  }
+  const PageId last_page_number = first_page_number + pages.size() - 1;
+  if (last_page_number >= readHeader().num_pages) {
+    throw InvalidPageException(last_page_number, filename_);
+  }
+  // Keep the on-disk next page pointers, as writePage() does.  The headers of
+  // the run are fetched with one read, its data landing in a shared scratch
+  // buffer.
+  std::vector<PageHeader> headers(pages.size());
+  std::vector<char> scratch(Page::DATA_SIZE);
+  std::vector<iovec> buffers;
+  for (PageHeader &header : headers) {
+    buffers.push_back({&header, sizeof(PageHeader)});
+    buffers.push_back({scratch.data(), Page::DATA_SIZE});
+  }
+  readVector(pagePosition(first_page_number), buffers);
+  buffers.clear();
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    const PageId page_number = first_page_number + i;
+    if (pages[i]->page_number() != page_number ||
+        headers[i].current_page_number == Page::INVALID_NUMBER) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(page_number, filename_);
+    }
+    const PageId next_page_number = headers[i].next_page_number;
+    headers[i] = headerToDisk(pages[i]->header_);
+    headers[i].next_page_number = next_page_number;
+    buffers.push_back({&headers[i], sizeof(PageHeader)});
+    buffers.push_back({const_cast<char *>(pages[i]->data_), Page::DATA_SIZE});
+  }
+  writeVector(pagePosition(first_page_number), buffers);
+  noteWrite(pages.size());
+}
+
+void File::writeRuns(IoEngine &engine, const std::vector<PageRun> &runs) {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  // Page headers are never aligned for O_DIRECT, so those files take the
+  // bounce buffer path one run at a time.
+  if (stream_->backend != FileBackend::POSIX) {
+    for (const PageRun &run : runs) {
+      writePages(run.first_page_number, run.pages);
+    }
+    return;
+  }
+  // Keep the on-disk next page pointers, as writePages() does.  The headers
+  // of every run are read in one batch and the runs written in another.
+  std::vector<std::vector<PageHeader>> headers(runs.size());
+  std::vector<char> scratch(Page::DATA_SIZE);
+  std::vector<IoRequest> requests(runs.size());
+  std::vector<IoRequest *> submitted;
+  const PageId num_pages = readHeader().num_pages;
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    const PageRun &run = runs[i];
+    if (run.pages.empty()) {
+      continue;
+    }
+    if (run.first_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(run.first_page_number, filename_);
+    }
+    const PageId last_page_number =
+        run.first_page_number + run.pages.size() - 1;
+    if (last_page_number >= num_pages) {
+      throw InvalidPageException(last_page_number, filename_);
+    }
+    headers[i].resize(run.pages.size());
+    requests[i].op = IoOp::READ;
+    requests[i].fd = stream_->fd;
+    requests[i].offset = pagePosition(run.first_page_number);
+    for (PageHeader &header : headers[i]) {
+      requests[i].buffers.push_back({&header, sizeof(PageHeader)});
+      requests[i].buffers.push_back({scratch.data(), Page::DATA_SIZE});
+    }
+    submitted.push_back(&requests[i]);
+  }
+  {
+    IoBatch batch;
+    engine.submit(submitted, batch);
+    batch.wait();
+  }
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    const PageRun &run = runs[i];
+    if (requests[i].error != 0) {
+      throw FileIOException(filename_, requests[i].error);
+    }
+    requests[i].op = IoOp::WRITE;
+    requests[i].offset = pagePosition(run.first_page_number);
+    requests[i].buffers.clear();
+    for (std::size_t j = 0; j < run.pages.size(); ++j) {
+      const PageId page_number = run.first_page_number + j;
+      PageHeader &header = headers[i][j];
+      if (run.pages[j]->page_number() != page_number ||
+          header.current_page_number == Page::INVALID_NUMBER) {
+        // Page has been deleted since it was read.
+        throw InvalidPageException(page_number, filename_);
+      }
+      const PageId next_page_number = header.next_page_number;
+      header = headerToDisk(run.pages[j]->header_);
+      header.next_page_number = next_page_number;
+      requests[i].buffers.push_back({&header, sizeof(PageHeader)});
+      requests[i].buffers.push_back(
+          {const_cast<char *>(run.pages[j]->data_), Page::DATA_SIZE});
+    }
+  }
+  {
+    IoBatch batch;
+    engine.submit(submitted, batch);
+    batch.wait();
+  }
+  std::uint64_t written = 0;
+  int error = 0;
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    if (requests[i].error == 0) {
+      written += runs[i].pages.size();
+    } else {
+      error = requests[i].error;
+    }
+  }
+  if (written > 0) {
+    noteWrite(written);
+  }
+  if (error != 0) {
+    throw FileIOException(filename_, error);
+  }
+}
+
 void File::deletePage(const PageId page_number) {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
   FileHeader header = readHeader();
   Page existing_page = readPage(page_number);
   Page previous_page;
@@ -212,30 +584,69 @@ void File::deletePage(const PageId page_number) {
   writeHeader(header);
 }
 
+const Page *File::mappedPage(const PageId page_number) const {
+  // Legacy files are version 1, so this covers their unaligned pages too.
+  if (stream_->mapping == nullptr || storesFreeSpaceBound()) {
+    return nullptr;
+  }
+  const std::size_t position = pagePosition(page_number);
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= readHeader().num_pages ||
+      position + Page::SIZE > stream_->mapping_length) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const Page *page =
+      reinterpret_cast<const Page *>(stream_->mapping + position);
+  if (!page->isUsed()) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return page;
+}
+
+void File::advise(const AccessPattern pattern) const {
+  if (stream_->mapping == nullptr) {
+    return;
+  }
+  int advice = MADV_NORMAL;
+  if (pattern == AccessPattern::SEQUENTIAL) {
+    advice = MADV_SEQUENTIAL;
+  } else if (pattern == AccessPattern::RANDOM) {
+    advice = MADV_RANDOM;
+  }
+  adviseRange(stream_->mapping, stream_->mapping_length, 0 /* pos */,
+              stream_->mapping_length, advice);
+}
+
 FileIterator File::begin() {
   const FileHeader &header = readHeader();
+  scanAhead(header.first_used_page);
   return FileIterator(this, header.first_used_page);
 }
 
 FileIterator File::end() { return FileIterator(this, Page::INVALID_NUMBER); }
 
-File::File(const std::string &name, const bool create_new)
-    : filename_(name), valid_(true) {
-  openIfNeeded(create_new);
+File::File(const std::string &name, const bool create_new,
+           const FileBackend backend, const FileFormat format)
+    : filename_(name), id_(INVALID_ID), valid_(true) {
+  openIfNeeded(create_new, backend, format);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
                          0 /* num_free_pages */, 0 /* first_free_page */};
     writeHeader(header);
+    flush();
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
+void File::openIfNeeded(const bool create_new, const FileBackend backend,
+                        const FileFormat format) {
+  std::lock_guard<std::mutex> guard(open_files_latch_);
   if (open_counts_.find(filename_) !=
       open_counts_.end()) {  // exists an entry already
     ++open_counts_[filename_];
     stream_ = open_streams_[filename_];
+    id_ = stream_->id;
   } else {
     std::ios_base::openmode mode =
         std::fstream::in | std::fstream::out | std::fstream::binary;
@@ -254,53 +665,588 @@ void File::openIfNeeded(const bool create_new) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
+    stream_.reset(new FileStream());
+    stream_->backend = backend;
+    stream_->format = format;
+    stream_->version = format == FileFormat::LEGACY ? 1 : FormatHeader::VERSION;
+    stream_->fd = -1;
+    stream_->mapping = nullptr;
+    stream_->mapping_length = 0;
+    if (backend == FileBackend::MMAP) {
+      stream_->fd = ::open(filename_.c_str(), O_RDONLY);
+      try {
+        if (stream_->fd < 0) {
+          throw FileIOException(filename_, errno);
+        }
+        mapFile();
+      } catch (...) {
+        stream_.reset();
+        throw;
+      }
+    } else if (backend != FileBackend::STREAM) {
+      const int flags = O_RDWR | (create_new ? O_CREAT | O_TRUNC : 0);
+      const int direct = backend == FileBackend::DIRECT ? O_DIRECT : 0;
+      stream_->fd = ::open(filename_.c_str(), flags | direct, 0644);
+      if (stream_->fd < 0 && errno == EINVAL &&
+          backend == FileBackend::DIRECT) {
+        // The filesystem does not support O_DIRECT.
+        stream_->backend = FileBackend::POSIX;
+        stream_->fd = ::open(filename_.c_str(), flags, 0644);
+      }
+      if (stream_->fd < 0) {
+        const int error = errno;
+        stream_.reset();
+        throw FileIOException(filename_, error);
+      }
+    } else {
+      stream_->stream.open(filename_, mode);
+    }
+    stream_->header_dirty = false;
+    stream_->header_write_back = HeaderWriteBack::ON_FLUSH;
+    stream_->durability = Durability::NONE;
+    stream_->sync_writes = 0;
+    stream_->sync_interval = std::chrono::milliseconds(0);
+    stream_->unsynced_writes = 0;
+    stream_->last_sync = std::chrono::steady_clock::now();
+    stream_->stats = FileStats();
+    if (!create_new) {
+      try {
+        readHeaderSlot();
+      } catch (...) {
+        valid_ = false;
+        stream_.reset();
+        throw;
+      }
+    }
+    stream_->id = next_id_++;
+    id_ = stream_->id;
     open_streams_[filename_] = stream_;
     open_counts_[filename_] = 1;
   }
 }
 
+void File::mapFile() {
+  struct stat status;
+  if (::fstat(stream_->fd, &status) != 0) {
+    throw FileIOException(filename_, errno);
+  }
+  if (status.st_size == 0) {
+    // mmap() refuses empty mappings; every read is past the end anyway.
+    return;
+  }
+  void *mapping = ::mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED,
+                         stream_->fd, 0 /* offset */);
+  if (mapping == MAP_FAILED) {
+    throw FileIOException(filename_, errno);
+  }
+  stream_->mapping = static_cast<const char *>(mapping);
+  stream_->mapping_length = status.st_size;
+  // Point lookups are the common case; keep the kernel from reading around
+  // every fault.  Scans ask for read-ahead through scanAhead().
+  adviseRange(stream_->mapping, stream_->mapping_length, 0 /* pos */,
+              stream_->mapping_length, MADV_RANDOM);
+}
+
+void File::scanAhead(const PageId page_number) const {
+  if (stream_->mapping == nullptr || page_number == Page::INVALID_NUMBER) {
+    return;
+  }
+  adviseRange(stream_->mapping, stream_->mapping_length,
+              pagePosition(page_number), SCAN_AHEAD_PAGES * Page::SIZE,
+              MADV_WILLNEED);
+}
+
 void File::close() {
-  --open_counts_[filename_];
+  if (!stream_) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(open_files_latch_);
+  if (open_counts_[filename_] == 1) {
+    // Write back while still registered, so that a concurrent open of the
+    // same file cannot read the stale header from disk.  If that throws, this
+    // File stays open.
+    flush();
+    open_streams_.erase(filename_);
+    open_counts_.erase(filename_);
+  } else {
+    --open_counts_[filename_];
+  }
   stream_.reset();
-  if (open_counts_[filename_] == 0) {
+  id_ = INVALID_ID;
+}
+
+void File::closeQuietly() noexcept {
+  try {
+    close();
+    return;
+  } catch (...) {
+  }
+  // The header could not be written back; release the file regardless.
+  std::lock_guard<std::mutex> guard(open_files_latch_);
+  if (--open_counts_[filename_] == 0) {
     open_streams_.erase(filename_);
     open_counts_.erase(filename_);
   }
+  stream_.reset();
+  id_ = INVALID_ID;
 }
 
 void File::writePage(const PageId page_number, const Page &new_page) {
-  writePage(page_number, new_page.header_, new_page);
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  if (storesFreeSpaceBound()) {
+    Page stored = new_page;
+    stored.header_ = headerToDisk(new_page.header_);
+    writeBytes(pagePosition(page_number),
+               reinterpret_cast<const char *>(&stored), Page::SIZE);
+  } else {
+    writeBytes(pagePosition(page_number),
+               reinterpret_cast<const char *>(&new_page), Page::SIZE);
+  }
+  noteWrite();
 }
 
 void File::writePage(const PageId page_number, const PageHeader &header,
                      const Page &new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  std::vector<iovec> buffers = {
+      {const_cast<PageHeader *>(&header), sizeof(header)},
+      {const_cast<char *>(new_page.data_), Page::DATA_SIZE}};
+  writeVector(pagePosition(page_number), buffers);
+  noteWrite();
 }
 
 FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
-
-  return header;
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  return stream_->header;
 }
 
 void File::writeHeader(const FileHeader &header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char *>(&header), sizeof(header));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  stream_->header = header;
+  stream_->header_dirty = true;
+  if (stream_->header_write_back == HeaderWriteBack::ON_UPDATE) {
+    writeBackHeader();
+    flushStream();
+  }
+}
+
+void File::readHeaderSlot() {
+  // A legacy file may be shorter than the slot, holding only its header, so
+  // read no further than its end and leave the rest of the slot zero.
+  alignas(DIRECT_ALIGNMENT) char slot[Page::SIZE] = {};
+  struct stat status;
+  if (::stat(filename_.c_str(), &status) != 0) {
+    throw FileIOException(filename_, errno);
+  }
+  const std::size_t length =
+      std::min<std::size_t>(status.st_size, sizeof(slot));
+  readBytes(0 /* pos */, slot, length);
+  if (stream_->backend == FileBackend::STREAM) {
+    // Do not leave the shared stream failed should the read have come short.
+    stream_->stream.clear();
+  }
+  FormatHeader format_header;
+  std::memcpy(&format_header, slot, sizeof(format_header));
+  if (format_header.magic != FormatHeader::MAGIC) {
+    stream_->format = FileFormat::LEGACY;
+    stream_->version = 1;
+    std::memcpy(&stream_->header, slot, sizeof(stream_->header));
+    return;
+  }
+  if (format_header.version < FormatHeader::MIN_VERSION ||
+      format_header.version > FormatHeader::VERSION) {
+    throw BadFileFormatException(
+        filename_,
+        "unsupported format version " + std::to_string(format_header.version));
+  }
+  if (format_header.page_size != Page::SIZE) {
+    throw BadFileFormatException(
+        filename_, "unsupported page size " +
+                       std::to_string(format_header.page_size));
+  }
+  // The checksum was computed with its own field zero.
+  std::memset(slot + offsetof(FormatHeader, checksum), 0,
+              sizeof(format_header.checksum));
+  if (crc32(slot, sizeof(slot)) != format_header.checksum) {
+    throw BadFileFormatException(filename_, "header checksum mismatch");
+  }
+  stream_->format = FileFormat::V2;
+  stream_->version = format_header.version;
+  stream_->header = format_header.header;
+}
+
+void File::writeBackHeader() {
+  if (!stream_->header_dirty) {
+    return;
+  }
+  if (stream_->format == FileFormat::LEGACY) {
+    writeBytes(0 /* pos */, reinterpret_cast<const char *>(&stream_->header),
+               sizeof(stream_->header));
+  } else {
+    // The whole slot is written, so with O_DIRECT it needs no bounce buffer.
+    alignas(DIRECT_ALIGNMENT) char slot[Page::SIZE] = {};
+    FormatHeader format_header = {};
+    format_header.magic = FormatHeader::MAGIC;
+    format_header.version = stream_->version;
+    format_header.page_size = Page::SIZE;
+    format_header.header = stream_->header;
+    std::memcpy(slot, &format_header, sizeof(format_header));
+    format_header.checksum = crc32(slot, sizeof(slot));
+    std::memcpy(slot + offsetof(FormatHeader, checksum),
+                &format_header.checksum, sizeof(format_header.checksum));
+    writeBytes(0 /* pos */, slot, sizeof(slot));
+  }
+  stream_->header_dirty = false;
+  noteWrite();
+}
+
+void File::flush() {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  writeBackHeader();
+  if (stream_->durability != Durability::NONE &&
+      stream_->unsynced_writes > 0) {
+    sync();
+  } else {
+    flushStream();
+  }
+}
+
+void File::setDurability(const Durability policy,
+                         const std::uint32_t sync_writes,
+                         const std::uint32_t sync_interval_ms) {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  stream_->durability = policy;
+  stream_->sync_writes = sync_writes;
+  stream_->sync_interval = std::chrono::milliseconds(sync_interval_ms);
+}
+
+FileStats File::getFileStats() const {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  return stream_->stats;
+}
+
+void File::noteWrite(const std::uint64_t writes) {
+  stream_->stats.writes += writes;
+  stream_->unsynced_writes += writes;
+  switch (stream_->durability) {
+    case Durability::EVERY_WRITE:
+      sync();
+      break;
+    case Durability::PERIODIC:
+      if ((stream_->sync_writes > 0 &&
+           stream_->unsynced_writes >= stream_->sync_writes) ||
+          (stream_->sync_interval.count() > 0 &&
+           std::chrono::steady_clock::now() - stream_->last_sync >=
+               stream_->sync_interval)) {
+        sync();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void File::sync() {
+  flushStream();
+  int fd = stream_->fd;
+  if (stream_->backend == FileBackend::STREAM) {
+    // std::fstream does not expose its descriptor; syncing any descriptor
+    // of the file writes back all of its data.
+    fd = ::open(filename_.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw FileIOException(filename_, errno);
+    }
+  }
+  const int result = ::fsync(fd);
+  const int error = errno;
+  if (stream_->backend == FileBackend::STREAM) {
+    ::close(fd);
+  }
+  if (result != 0) {
+    throw FileIOException(filename_, error);
+  }
+  ++stream_->stats.syncs;
+  stream_->unsynced_writes = 0;
+  stream_->last_sync = std::chrono::steady_clock::now();
+}
+
+void File::setHeaderWriteBack(const HeaderWriteBack policy) {
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  stream_->header_write_back = policy;
+  if (policy == HeaderWriteBack::ON_UPDATE) {
+    flush();
+  }
+}
+
+void File::pageFromDisk(Page &page) const {
+  if (storesFreeSpaceBound()) {
+    page.rebuildFreeSlotList();
+  }
+}
+
+PageHeader File::headerToDisk(const PageHeader &header) const {
+  PageHeader stored = header;
+  if (storesFreeSpaceBound()) {
+    stored.free_slot_head = header.num_slots * sizeof(PageSlot);
+  }
+  return stored;
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char *>(&header), sizeof(header));
+  readBytes(pagePosition(page_number), reinterpret_cast<char *>(&header),
+            sizeof(header));
 
   return header;
 }
 
+void File::readBytes(const std::streamoff position, char *data,
+                     const std::size_t length) const {
+  if (stream_->backend == FileBackend::STREAM) {
+    std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+    stream_->stream.seekg(position, std::ios::beg);
+    stream_->stream.read(data, length);
+    return;
+  }
+  if (stream_->backend == FileBackend::DIRECT ||
+      stream_->backend == FileBackend::MMAP) {
+    std::vector<iovec> buffers = {{data, length}};
+    readVector(position, buffers);
+    return;
+  }
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t count =
+        ::pread(stream_->fd, data + done, length - done, position + done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, errno);
+    }
+    if (count == 0) {
+      // Past the end of the file, which reads as zeroes.
+      std::memset(data + done, 0, length - done);
+      return;
+    }
+    done += count;
+  }
+}
+
+void File::writeBytes(const std::streamoff position, const char *data,
+                      const std::size_t length) {
+  if (stream_->backend == FileBackend::MMAP) {
+    throw ReadOnlyFileException(filename_);
+  }
+  if (stream_->backend == FileBackend::STREAM) {
+    std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+    stream_->stream.seekp(position, std::ios::beg);
+    stream_->stream.write(data, length);
+    return;
+  }
+  if (stream_->backend == FileBackend::DIRECT) {
+    std::vector<iovec> buffers = {{const_cast<char *>(data), length}};
+    writeVector(position, buffers);
+    return;
+  }
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t count =
+        ::pwrite(stream_->fd, data + done, length - done, position + done);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, errno);
+    }
+    done += count;
+  }
+}
+
+void File::readVector(std::streamoff position,
+                      std::vector<iovec> &buffers) const {
+  if (stream_->backend == FileBackend::STREAM) {
+    std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+    for (const iovec &buffer : buffers) {
+      readBytes(position, static_cast<char *>(buffer.iov_base),
+                buffer.iov_len);
+      position += buffer.iov_len;
+    }
+    return;
+  }
+  if (stream_->backend == FileBackend::MMAP) {
+    for (const iovec &buffer : buffers) {
+      // Past the end of the mapping, which reads as zeroes.
+      const std::size_t start =
+          std::min<std::size_t>(position, stream_->mapping_length);
+      const std::size_t mapped =
+          std::min(buffer.iov_len, stream_->mapping_length - start);
+      if (mapped > 0) {
+        std::memcpy(buffer.iov_base, stream_->mapping + start, mapped);
+      }
+      std::memset(static_cast<char *>(buffer.iov_base) + mapped, 0,
+                  buffer.iov_len - mapped);
+      position += buffer.iov_len;
+    }
+    return;
+  }
+  if (stream_->backend == FileBackend::DIRECT &&
+      !isDirectAligned(position, buffers)) {
+    bounceRead(position, buffers);
+    return;
+  }
+  std::size_t first = 0;
+  while (first < buffers.size()) {
+    const int count =
+        static_cast<int>(std::min<std::size_t>(buffers.size() - first, IOV_MAX));
+    ssize_t done = ::preadv(stream_->fd, &buffers[first], count, position);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, errno);
+    }
+    position += done;
+    // Skip the buffers filled and trim a partly filled one.
+    const bool more = done > 0;
+    while (first < buffers.size() &&
+           static_cast<std::size_t>(done) >= buffers[first].iov_len) {
+      done -= buffers[first].iov_len;
+      ++first;
+    }
+    if (done > 0) {
+      buffers[first].iov_base = static_cast<char *>(buffers[first].iov_base) + done;
+      buffers[first].iov_len -= done;
+    }
+    // A read that ends short of a block boundary with O_DIRECT has reached
+    // the end of the file just as an empty read has.
+    if (!more || (stream_->backend == FileBackend::DIRECT &&
+                  position % DIRECT_ALIGNMENT != 0)) {
+      // Past the end of the file, which reads as zeroes.
+      for (; first < buffers.size(); ++first) {
+        std::memset(buffers[first].iov_base, 0, buffers[first].iov_len);
+      }
+      return;
+    }
+  }
+}
+
+void File::writeVector(std::streamoff position, std::vector<iovec> &buffers) {
+  if (stream_->backend == FileBackend::MMAP) {
+    throw ReadOnlyFileException(filename_);
+  }
+  if (stream_->backend == FileBackend::STREAM) {
+    std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+    for (const iovec &buffer : buffers) {
+      writeBytes(position, static_cast<const char *>(buffer.iov_base),
+                 buffer.iov_len);
+      position += buffer.iov_len;
+    }
+    return;
+  }
+  if (stream_->backend == FileBackend::DIRECT &&
+      !isDirectAligned(position, buffers)) {
+    bounceWrite(position, buffers);
+    return;
+  }
+  std::size_t first = 0;
+  while (first < buffers.size()) {
+    const int count =
+        static_cast<int>(std::min<std::size_t>(buffers.size() - first, IOV_MAX));
+    ssize_t done = ::pwritev(stream_->fd, &buffers[first], count, position);
+    if (done < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, errno);
+    }
+    position += done;
+    // Skip the buffers written and trim a partly written one.
+    while (first < buffers.size() &&
+           static_cast<std::size_t>(done) >= buffers[first].iov_len) {
+      done -= buffers[first].iov_len;
+      ++first;
+    }
+    if (done > 0) {
+      buffers[first].iov_base = static_cast<char *>(buffers[first].iov_base) + done;
+      buffers[first].iov_len -= done;
+    }
+  }
+}
+
+bool File::isDirectAligned(const std::streamoff position,
+                           const std::vector<iovec> &buffers) {
+  if (position % DIRECT_ALIGNMENT != 0) {
+    return false;
+  }
+  for (const iovec &buffer : buffers) {
+    if (reinterpret_cast<std::uintptr_t>(buffer.iov_base) % DIRECT_ALIGNMENT !=
+            0 ||
+        buffer.iov_len % DIRECT_ALIGNMENT != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void File::bounceRead(const std::streamoff position,
+                      const std::vector<iovec> &buffers) const {
+  std::size_t length = 0;
+  for (const iovec &buffer : buffers) {
+    length += buffer.iov_len;
+  }
+  const std::streamoff start = alignDown(position);
+  const std::size_t span = alignUp(position + length) - start;
+  AlignedBuffer bounce = allocateAligned(span);
+  std::vector<iovec> aligned = {{bounce.get(), span}};
+  readVector(start, aligned);
+  const char *data = bounce.get() + (position - start);
+  for (const iovec &buffer : buffers) {
+    std::memcpy(buffer.iov_base, data, buffer.iov_len);
+    data += buffer.iov_len;
+  }
+}
+
+void File::bounceWrite(const std::streamoff position,
+                       const std::vector<iovec> &buffers) {
+  // The blocks at the edges are read, patched and written back whole, so
+  // writes sharing a block must not interleave.
+  std::lock_guard<std::recursive_mutex> guard(stream_->latch);
+  std::size_t length = 0;
+  for (const iovec &buffer : buffers) {
+    length += buffer.iov_len;
+  }
+  const std::streamoff start = alignDown(position);
+  const std::streamoff end = alignUp(position + length);
+  const std::size_t span = end - start;
+  AlignedBuffer bounce = allocateAligned(span);
+  if (position != start) {
+    std::vector<iovec> head = {{bounce.get(), DIRECT_ALIGNMENT}};
+    readVector(start, head);
+  }
+  const std::streamoff last = end - DIRECT_ALIGNMENT;
+  if (position + static_cast<std::streamoff>(length) != end &&
+      (last != start || position == start)) {
+    std::vector<iovec> tail = {
+        {bounce.get() + (last - start), DIRECT_ALIGNMENT}};
+    readVector(last, tail);
+  }
+  char *data = bounce.get() + (position - start);
+  for (const iovec &buffer : buffers) {
+    std::memcpy(data, buffer.iov_base, buffer.iov_len);
+    data += buffer.iov_len;
+  }
+  std::vector<iovec> aligned = {{bounce.get(), span}};
+  writeVector(start, aligned);
+}
+
+void File::flushStream() {
+  // pwrite() hands data straight to the kernel, so only the stream backend
+  // has anything buffered.
+  if (stream_->backend == FileBackend::STREAM) {
+    stream_->stream.flush();
+    ++stream_->stats.flushes;
+  }
+}
+
 }  // namespace badgerdb
@@ -8,11 +8,19 @@
 
 #pragma once
 
+#include <sys/uio.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
+#include "io_engine.h"
 #include "page.h"
 
 namespace badgerdb {
@@ -56,6 +64,315 @@ struct FileHeader {
   }
 };
 
+/**
+ * @brief Layout of a file on disk.
+ */
+enum class FileFormat {
+  /**
+   * The original layout: the FileHeader alone at the start of the file and
+   * page N right after it, at sizeof(FileHeader) + (N - 1) * Page::SIZE, so
+   * every page straddles filesystem blocks.
+   */
+  LEGACY,
+
+  /**
+   * Version 2 and later: a page-sized header slot holding a FormatHeader,
+   * and page N at N * Page::SIZE, so every page is block aligned.  Version 3
+   * stores the free slot list of every page; see PageHeader::free_slot_head.
+   */
+  V2
+};
+
+/**
+ * @brief Start of the header slot of a FileFormat::V2 file.  The rest of the
+ *        slot is zero, left for future metadata.
+ */
+struct FormatHeader {
+  /**
+   * Value of magic in BadgerDB files: "BADGERDB" in little-endian order.
+   */
+  static const std::uint64_t MAGIC = 0x4244524547444142ULL;
+
+  /**
+   * Value of version in files created by this build.
+   */
+  static const std::uint32_t VERSION = 3;
+
+  /**
+   * Oldest version this build opens.  Files keep their version when written
+   * to, so older builds can still read them, until File::convert()
+   * upgrades them.
+   */
+  static const std::uint32_t MIN_VERSION = 2;
+
+  /**
+   * Identifies the file as a BadgerDB file.
+   */
+  std::uint64_t magic;
+
+  /**
+   * Version of the format.
+   */
+  std::uint32_t version;
+
+  /**
+   * Size of the pages in the file.
+   */
+  std::uint32_t page_size;
+
+  /**
+   * CRC-32 of the whole header slot, computed with this field zero.
+   */
+  std::uint32_t checksum;
+
+  /**
+   * Zero.
+   */
+  std::uint32_t reserved;
+
+  /**
+   * Header metadata of the file.
+   */
+  FileHeader header;
+};
+
+/**
+ * @brief When a file's cached header is written back to disk.
+ */
+enum class HeaderWriteBack {
+  /**
+   * On File::flush() and when the last File object for the file is closed.
+   */
+  ON_FLUSH,
+
+  /**
+   * Every time the header changes.
+   */
+  ON_UPDATE
+};
+
+/**
+ * @brief When writes to a file are forced to stable storage with fsync().
+ */
+enum class Durability {
+  /**
+   * Never; the operating system writes data back when it sees fit.
+   */
+  NONE,
+
+  /**
+   * On File::flush() and when the last File object for the file is closed.
+   */
+  ON_CLOSE,
+
+  /**
+   * As ON_CLOSE, and also at the first write after a set number of writes or
+   * milliseconds since the last sync.
+   */
+  PERIODIC,
+
+  /**
+   * After every write.
+   */
+  EVERY_WRITE
+};
+
+/**
+ * @brief Counts of the writes, flushes and syncs issued on a file.
+ */
+struct FileStats {
+  /**
+   * Number of page and header writes.
+   */
+  std::uint64_t writes;
+
+  /**
+   * Number of times buffered stream data was flushed to the operating system.
+   */
+  std::uint64_t flushes;
+
+  /**
+   * Number of fsync() calls.
+   */
+  std::uint64_t syncs;
+};
+
+/**
+ * @brief How a file's pages are read from and written to disk.
+ */
+enum class FileBackend {
+  /**
+   * Positional pread()/pwrite() on a file descriptor.  Readers of the same
+   * file do not serialize on a shared stream position.
+   */
+  POSIX,
+
+  /**
+   * Seek and read/write on a std::fstream, serialized by the file's latch.
+   */
+  STREAM,
+
+  /**
+   * As POSIX, with the file opened with O_DIRECT so that its pages are not
+   * also cached by the operating system.  Transfers not aligned to
+   * File::DIRECT_ALIGNMENT go through an aligned bounce buffer, writes
+   * reading back the partial blocks at their edges.  Falls back to POSIX
+   * if the filesystem does not support O_DIRECT.
+   */
+  DIRECT,
+
+  /**
+   * Read-only: the whole file is mapped into memory with mmap(), reads copy
+   * out of the mapping and File::mappedPage() hands out pointers into it.
+   * Creating or writing to the file throws ReadOnlyFileException.
+   */
+  MMAP
+};
+
+/**
+ * @brief Expected order of accesses to a file, passed to File::advise().
+ */
+enum class AccessPattern {
+  /**
+   * No particular order; the operating system's default read-ahead.
+   */
+  NORMAL,
+
+  /**
+   * Pages in increasing order, as by a FileIterator scan: read well ahead.
+   */
+  SEQUENTIAL,
+
+  /**
+   * Point lookups: read only the pages touched.
+   */
+  RANDOM
+};
+
+/**
+ * @brief A run of consecutive pages to write with File::writeRuns().
+ */
+struct PageRun {
+  /**
+   * Number of the first page of the run.
+   */
+  PageId first_page_number;
+
+  /**
+   * Pages to write, in page number order.
+   */
+  std::vector<const Page *> pages;
+};
+
+/**
+ * @brief Stream, latch and cached header shared by every File object that
+ *        refers to the same file on disk.
+ */
+struct FileStream {
+  /**
+   * Unmaps the file and closes the file descriptor, if any.
+   */
+  ~FileStream();
+
+  /**
+   * How the file is accessed.
+   */
+  FileBackend backend;
+
+  /**
+   * Layout of the file on disk.
+   */
+  FileFormat format;
+
+  /**
+   * Format version of the file: that of its FormatHeader, or 1 if format is
+   * FileFormat::LEGACY.
+   */
+  std::uint32_t version;
+
+  /**
+   * Stream for the underlying filesystem object, if backend is STREAM.
+   */
+  std::fstream stream;
+
+  /**
+   * Descriptor of the underlying filesystem object if backend is POSIX,
+   * DIRECT or MMAP, -1 otherwise.
+   */
+  int fd;
+
+  /**
+   * The file mapped read-only if backend is MMAP and the file is not empty,
+   * null otherwise.
+   */
+  const char *mapping;
+
+  /**
+   * Length of mapping: the size of the file when it was opened.
+   */
+  std::size_t mapping_length;
+
+  /**
+   * Identifier assigned to the file when it was opened.
+   */
+  FileId id;
+
+  /**
+   * Serializes access to the stream (but not to fd) and to the file's header
+   * and page links.  Recursive since the public File operations are built on
+   * each other.
+   */
+  std::recursive_mutex latch;
+
+  /**
+   * Authoritative copy of the file's header.  The copy on disk may be stale
+   * until the header is written back.
+   */
+  FileHeader header;
+
+  /**
+   * Whether header has changed since it was last written to disk.
+   */
+  bool header_dirty;
+
+  /**
+   * When header is written back to disk.
+   */
+  HeaderWriteBack header_write_back;
+
+  /**
+   * When writes are forced to stable storage.
+   */
+  Durability durability;
+
+  /**
+   * With Durability::PERIODIC, sync once this many writes are unsynced (0 to
+   * not sync by count).
+   */
+  std::uint32_t sync_writes;
+
+  /**
+   * With Durability::PERIODIC, sync once this long has passed since the last
+   * sync (0 to not sync by time).
+   */
+  std::chrono::milliseconds sync_interval;
+
+  /**
+   * Number of writes since the last sync.
+   */
+  std::uint32_t unsynced_writes;
+
+  /**
+   * Time of the last sync.
+   */
+  std::chrono::steady_clock::time_point last_sync;
+
+  /**
+   * Writes, flushes and syncs issued so far.
+   */
+  FileStats stats;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
@@ -69,17 +386,35 @@ struct FileHeader {
  * returns a file object with the already created stream for the file without
  * actually opening the UNIX file again.
  *
- * @warning This class is not threadsafe.
+ * File objects may be used from several threads at once; all operations on
+ * the same underlying file are serialized by the latch in its FileStream.
  */
 class File {
  public:
+  /**
+   * Identifier of invalid files.  Open files never get this identifier.
+   */
+  static const FileId INVALID_ID = 0;
+
+  /**
+   * Alignment of file positions, lengths and memory required for transfers
+   * to bypass the bounce buffer with FileBackend::DIRECT.  Covers the
+   * logical block size of common devices.
+   */
+  static const std::size_t DIRECT_ALIGNMENT = 4096;
+
   /**
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param backend   How to access the file.
+   * @param format    Layout of the file on disk.
    * @throws  FileExistsException     If the requested file already exists.
+   * @throws  ReadOnlyFileException   If backend is FileBackend::MMAP.
    */
-  static File create(const std::string &filename);
+  static File create(const std::string &filename,
+                     const FileBackend backend = FileBackend::POSIX,
+                     const FileFormat format = FileFormat::V2);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
@@ -92,9 +427,14 @@ class File {
    * open_streams_ map.
    *
    * @param filename  Name of the file.
+   * @param backend   How to access the file.  Ignored if the file is already
+   *                  open, in which case the existing backend is shared.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  BadFileFormatException  If the file's header is corrupt or of
+   *                                  an unsupported version or page size.
    */
-  static File open(const std::string &filename);
+  static File open(const std::string &filename,
+                   const FileBackend backend = FileBackend::POSIX);
 
   /**
    * Deletes an existing file.
@@ -105,6 +445,20 @@ class File {
    */
   static void remove(const std::string &filename);
 
+  /**
+   * Rewrites a file in the given format, keeping its pages, their numbers
+   * and its free list.  The file is written to filename.convert first and
+   * renamed over the original once complete.  Does nothing if the file is
+   * already in the given format.
+   *
+   * @param filename  Name of the file.
+   * @param format    Layout to convert it to.
+   * @throws  FileNotFoundException   If the file doesn't exist.
+   * @throws  FileOpenException       If the file is currently open.
+   * @throws  BadFileFormatException  If the file's header is corrupt.
+   */
+  static void convert(const std::string &filename, const FileFormat format);
+
   /**
    * Returns true if the file exists and is open.
    *
@@ -136,22 +490,29 @@ class File {
   File &operator=(const File &rhs);
 
   /**
-   * Check if two files are equal.
+   * Check if two files are equal.  Open handles on the same file share its
+   * id, so this is an integer compare unless both handles are closed, in
+   * which case their names are compared.
    * @param rhs File object to compare.
    * @return True if the two files are equal.
    */
-  bool operator==(const File &rhs) const { return filename_ == rhs.filename_; }
+  bool operator==(const File &rhs) const {
+    if (id_ != INVALID_ID || rhs.id_ != INVALID_ID) {
+      return id_ == rhs.id_;
+    }
+    return filename_ == rhs.filename_;
+  }
 
   /**
    * Check if two files are not equal.
    * @param rhs File object to compare.
    * @return True if the two files are not equal.
    */
-  bool operator!=(const File &rhs) const { return filename_ != rhs.filename_; }
+  bool operator!=(const File &rhs) const { return !(*this == rhs); }
 
   /**
    * Destructor that automatically closes the underlying file if no other
-   * File objects are using it.
+   * File objects are using it.  Errors writing back the header are ignored.
    */
   ~File();
 
@@ -181,6 +542,37 @@ class File {
    */
   void writePage(const Page &new_page);
 
+  /**
+   * Writes a run of consecutive pages into the file with a single vectored
+   * write, as if by calling writePage() for each, reading the on-disk page
+   * headers it keeps with a single read as well.  The pages must have been
+   * allocated in this file and be numbered first_page_number onwards.
+   *
+   * @see writePage()
+   * @param first_page_number   Number of the first page of the run.
+   * @param pages               Pages to write, in page number order.
+   * @throws  InvalidPageException  If a page doesn't exist in the file or
+   *                                has been deleted.
+   */
+  void writePages(const PageId first_page_number,
+                  const std::vector<const Page *> &pages);
+
+  /**
+   * Writes several runs of consecutive pages, as if by calling writePages()
+   * for each, with all of the runs in flight at once on the given engine.
+   * Files using the STREAM backend write the runs one at a time instead.
+   *
+   * @see writePages()
+   * @param engine  Engine to carry out the reads and writes.
+   * @param runs    Runs to write; they must not overlap.
+   * @throws  InvalidPageException  If a page doesn't exist in the file or
+   *                                has been deleted, in which case nothing
+   *                                is written.
+   * @throws  FileIOException       If a read or write fails, in which case
+   *                                other runs may have been written.
+   */
+  void writeRuns(IoEngine &engine, const std::vector<PageRun> &runs);
+
   /**
    * Deletes a page from the file.
    *
@@ -188,6 +580,82 @@ class File {
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Returns a page of a file opened with FileBackend::MMAP in place, without
+   * copying it.  The pointer stays valid while any File object is open on
+   * the file.
+   *
+   * @param page_number   Number of page.
+   * @return  The page, or null if the file is not mapped, is in
+   *          FileFormat::LEGACY, whose pages are not aligned as a Page must
+   *          be, or predates format version 3, whose pages do not store
+   *          their free slot list.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  const Page *mappedPage(const PageId page_number) const;
+
+  /**
+   * Tells the operating system how the file's pages are about to be read,
+   * for all File objects open on it.  Mapped files start out as
+   * AccessPattern::RANDOM; FileIterator reads ahead of a scan by itself.
+   * Does nothing unless the file uses FileBackend::MMAP.
+   *
+   * @param pattern   Expected order of accesses.
+   */
+  void advise(const AccessPattern pattern) const;
+
+  /**
+   * Writes the cached file header back to disk if it has changed and flushes
+   * the underlying stream.  Unless durability is Durability::NONE, also syncs
+   * the file to stable storage if anything was written since the last sync.
+   */
+  void flush();
+
+  /**
+   * Closes the underlying file stream in <stream_>.
+   * This method only closes the file if no other File objects exist that access
+   * the same file, writing back its cached header first.  Closing an invalid or
+   * already closed File does nothing.  The destructor closes the file too, but
+   * cannot report a failed write back; call this to see it.
+   *
+   * @throws  FileIOException  If the header cannot be written back or the file
+   *                           synced.  The File is left open.
+   */
+  void close();
+
+  /**
+   * Sets when writes to the file are forced to stable storage.  The setting
+   * applies to all File objects open on the same file.  Defaults to
+   * Durability::NONE.
+   *
+   * @param policy        When to sync.
+   * @param sync_writes   With Durability::PERIODIC, number of writes after
+   *                      which to sync, or 0 for no limit.
+   * @param sync_interval_ms  With Durability::PERIODIC, milliseconds after
+   *                      which to sync, or 0 for no limit.
+   */
+  void setDurability(const Durability policy,
+                     const std::uint32_t sync_writes = 0,
+                     const std::uint32_t sync_interval_ms = 0);
+
+  /**
+   * Returns the counts of writes, flushes and syncs issued on the file by all
+   * File objects open on it.
+   *
+   * @return  I/O counts of the file.
+   */
+  FileStats getFileStats() const;
+
+  /**
+   * Sets when the cached file header is written back to disk.  The setting
+   * applies to all File objects open on the same file.  Defaults to
+   * HeaderWriteBack::ON_FLUSH.
+   *
+   * @param policy  When to write the header back.
+   */
+  void setHeaderWriteBack(const HeaderWriteBack policy);
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -195,6 +663,30 @@ class File {
    */
   const std::string &filename() const { return filename_; }
 
+  /**
+   * Returns the identifier of the file this object represents.  The
+   * identifier is the same for all File objects open on the same file, and is
+   * not reused while any of them exist.
+   *
+   * @return  Identifier of file, or INVALID_ID if the file is not open.
+   */
+  FileId id() const { return id_; }
+
+  /**
+   * Returns the layout of the file on disk.  The file must be open.
+   *
+   * @return  Format of file.
+   */
+  FileFormat format() const { return stream_->format; }
+
+  /**
+   * Returns the format version of the file.  The file must be open.
+   *
+   * @return  FormatHeader::VERSION or older, or 1 if the file is in
+   *          FileFormat::LEGACY.
+   */
+  std::uint32_t formatVersion() const { return stream_->version; }
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -221,7 +713,7 @@ class File {
    * Creates an empty file
    * @return File object with valid_ bit set to false
    */
-  File() : valid_(false) {}
+  File() : id_(INVALID_ID), valid_(false) {}
 
  private:
   friend class BufMgr;
@@ -235,12 +727,16 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param backend     How to access the file.
+   * @param format      Layout of the file if it is created.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  explicit File(const std::string &name, const bool create_new);
+  explicit File(const std::string &name, const bool create_new,
+                const FileBackend backend,
+                const FileFormat format = FileFormat::V2);
 
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -249,29 +745,86 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  std::streampos pagePosition(const PageId page_number) const {
+    if (stream_->format == FileFormat::LEGACY) {
+      return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    }
+    return static_cast<std::streamoff>(page_number) * Page::SIZE;
   }
 
+  /**
+   * Returns whether the file's pages hold the free space lower bound in
+   * place of PageHeader::free_slot_head, as files before format version 3
+   * do.
+   */
+  bool storesFreeSpaceBound() const { return stream_->version < 3; }
+
+  /**
+   * Readies a page just read from disk for use, building its free slot list
+   * if the file does not store it.
+   *
+   * @param page  Page read.
+   */
+  void pageFromDisk(Page &page) const;
+
+  /**
+   * Returns a page header as it is to be written to disk: with the free
+   * space lower bound in place of the free slot list head if the file
+   * stores that.
+   *
+   * @param header  Header of the page in memory.
+   * @return  Header to write.
+   */
+  PageHeader headerToDisk(const PageHeader &header) const;
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
    * the same filesystem file; otherwise, it reuses the existing stream.
    *
    * @param create_new  Whether to create a new file.
+   * @param backend     How to access the file if it has to be opened.
+   * @param format      Layout of the file if it is created.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  FileIOException         If the file cannot be opened.
+   * @throws  BadFileFormatException  If the file's header is rejected.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const FileBackend backend,
+                    const FileFormat format = FileFormat::V2);
 
   /**
-   * Closes the underlying file stream in <stream_>.
-   * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * Maps the file opened read-only on the stream's descriptor.
+   *
+   * @throws  FileIOException   If the file cannot be mapped.
    */
-  void close();
+  void mapFile();
+
+  /**
+   * Asks the operating system to read in the SCAN_AHEAD_PAGES pages from the
+   * given one on, if the file is mapped.  Called by FileIterator.
+   *
+   * @param page_number   Number of the first page to read in.
+   */
+  void scanAhead(const PageId page_number) const;
+
+  /**
+   * Reads the header of a file being opened into the stream, working out
+   * its format.  Files without a FormatHeader are FileFormat::LEGACY.
+   *
+   * @throws  BadFileFormatException  If the header is corrupt or of an
+   *                                  unsupported version or page size.
+   */
+  void readHeaderSlot();
+
+  /**
+   * Closes the underlying file stream in <stream_> without throwing.  If the
+   * cached header cannot be written back, the file is closed regardless and
+   * the error is lost; see close().
+   */
+  void closeQuietly() noexcept;
 
   /**
    * Reads a page from the file.  If <allow_free> is not set, an exception
@@ -288,6 +841,64 @@ class File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads an existing page from the file directly into the given page,
+   * which is left in an unspecified state if an exception is thrown.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page &page) const;
+
+  /**
+   * Reads a run of consecutive existing pages with a single read, directly
+   * into the given pages.  They are left in an unspecified state if an
+   * exception is thrown.
+   *
+   * @param first_page_number   Number of the first page to read.
+   * @param pages               Pages to read into, one per page of the run.
+   * @throws  InvalidPageException  If any page of the run doesn't exist in
+   *                                the file or is not currently used.
+   */
+  void readPages(const PageId first_page_number,
+                 const std::vector<Page *> &pages) const;
+
+  /**
+   * Starts reading a run of consecutive existing pages directly into the
+   * given pages, to be finished by finishReadPages() once the batch has been
+   * waited for.  Files using the STREAM or MMAP backend read the run before
+   * returning.
+   *
+   * @param engine              Engine to submit the read to.
+   * @param batch               Batch to submit the read with.
+   * @param request             Request to carry the read; it must stay
+   *                            alive until the batch has been waited for.
+   * @param first_page_number   Number of the first page to read.
+   * @param pages               Pages to read into, one per page of the run.
+   * @throws  InvalidPageException  If the run goes past the end of the file,
+   *                                in which case nothing is submitted.
+   */
+  void startReadPages(IoEngine &engine, IoBatch &batch, IoRequest &request,
+                      const PageId first_page_number,
+                      const std::vector<Page *> &pages) const;
+
+  /**
+   * Checks the outcome of a read started by startReadPages().  The pages
+   * are left in an unspecified state if an exception is thrown.
+   *
+   * @param request             Request carrying the read.
+   * @param first_page_number   Number of the first page read.
+   * @param pages               Pages read into.
+   * @throws  InvalidPageException  If any page of the run is not currently
+   *                                used.
+   * @throws  FileIOException       If the read failed.
+   */
+  void finishReadPages(const IoRequest &request,
+                       const PageId first_page_number,
+                       const std::vector<Page *> &pages) const;
+
   /**
    * Writes a page into the file at the given page number.  This does not
    * update ensure that the number in the header equals the position on disk.
@@ -311,19 +922,26 @@ class File {
                  const Page &new_page);
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file from the header cache.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the cached header for this file.  The header is written to disk
+   * now or later depending on the file's HeaderWriteBack policy.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader &header);
 
+  /**
+   * Writes the cached header to disk if it has changed since it was last
+   * written, in the file's format.  The caller must hold the stream's latch.
+   */
+  void writeBackHeader();
+
   /**
    * Reads only the header of the given page from disk (not the record data
    * or slot table).  No bounds checking is performed.
@@ -333,7 +951,112 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream>> StreamMap;
+  /**
+   * Reads bytes from the file at the given position.  Bytes past the end of
+   * the file read as zeroes with the POSIX backend.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param data      Buffer to read into.
+   * @param length    Number of bytes to read.
+   * @throws  FileIOException   If the read fails.
+   */
+  void readBytes(const std::streamoff position, char *data,
+                 const std::size_t length) const;
+
+  /**
+   * Writes bytes to the file at the given position.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param data      Bytes to write.
+   * @param length    Number of bytes to write.
+   * @throws  FileIOException         If the write fails.
+   * @throws  ReadOnlyFileException   If the file is mapped read-only.
+   */
+  void writeBytes(const std::streamoff position, const char *data,
+                  const std::size_t length);
+
+  /**
+   * Reads consecutive bytes from the file into several buffers, with
+   * preadv() on the POSIX backend.  Bytes past the end of the file read as
+   * zeroes with the POSIX backend.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param buffers   Buffers to fill in order; consumed by the call.
+   * @throws  FileIOException   If the read fails.
+   */
+  void readVector(std::streamoff position, std::vector<iovec> &buffers) const;
+
+  /**
+   * Writes the contents of several buffers to consecutive bytes of the
+   * file, with pwritev() on the POSIX backend.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param buffers   Buffers to write in order; consumed by the call.
+   * @throws  FileIOException         If the write fails.
+   * @throws  ReadOnlyFileException   If the file is mapped read-only.
+   */
+  void writeVector(std::streamoff position, std::vector<iovec> &buffers);
+
+  /**
+   * Returns true if a transfer can be made with O_DIRECT as it is.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param buffers   Buffers of the transfer.
+   */
+  static bool isDirectAligned(const std::streamoff position,
+                              const std::vector<iovec> &buffers);
+
+  /**
+   * Reads consecutive bytes into several buffers through an aligned bounce
+   * buffer covering the blocks they span.  For FileBackend::DIRECT.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param buffers   Buffers to fill in order.
+   * @throws  FileIOException   If the read fails.
+   */
+  void bounceRead(const std::streamoff position,
+                  const std::vector<iovec> &buffers) const;
+
+  /**
+   * Writes several buffers to consecutive bytes through an aligned bounce
+   * buffer covering the blocks they span, keeping the rest of the partial
+   * blocks at the edges.  For FileBackend::DIRECT.
+   *
+   * @param position  Offset from the beginning of the file.
+   * @param buffers   Buffers to write in order.
+   * @throws  FileIOException   If a read or write fails.
+   */
+  void bounceWrite(const std::streamoff position,
+                   const std::vector<iovec> &buffers);
+
+  /**
+   * Hands data buffered in user space, if any, to the operating system.
+   */
+  void flushStream();
+
+  /**
+   * Counts writes and syncs the file if the durability policy asks for it.
+   * The caller must hold the stream's latch.
+   *
+   * @param writes  Number of pages or headers written.
+   */
+  void noteWrite(const std::uint64_t writes = 1);
+
+  /**
+   * Flushes the stream and forces the file's data to stable storage.  The
+   * caller must hold the stream's latch.
+   *
+   * @throws  FileIOException   If the sync fails.
+   */
+  void sync();
+
+  /**
+   * Number of pages FileIterator asks to be read ahead of a scan of a mapped
+   * file at a time.
+   */
+  static const PageId SCAN_AHEAD_PAGES = 32;
+
+  typedef std::map<std::string, std::shared_ptr<FileStream>> StreamMap;
   typedef std::map<std::string, int> CountMap;
 
   /**
@@ -346,15 +1069,31 @@ class File {
    */
   static CountMap open_counts_;
 
+  /**
+   * Identifier to give the next file opened.
+   */
+  static FileId next_id_;
+
+  /**
+   * Guards open_streams_, open_counts_ and next_id_.
+   */
+  static std::mutex open_files_latch_;
+
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Identifier of the file this object represents.
+   */
+  FileId id_;
+
+  /**
+   * Stream for underlying filesystem object.  Null for invalid or closed
+   * files.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<FileStream> stream_;
 
   /**
    * Whether this file is valid.
@@ -20,7 +20,8 @@ namespace badgerdb {
  * @brief Iterator for iterating over the pages in a file.
  *
  * This class provides a forward-only iterator for iterating over all of the
- * pages in a file.
+ * pages in a file.  On a mapped file it asks for the pages ahead of it to be
+ * read in, File::SCAN_AHEAD_PAGES at a time.
  */
 class FileIterator {
  public:
@@ -39,6 +40,7 @@ class FileIterator {
     assert(file_ != NULL);
     const FileHeader &header = file_->readHeader();
     current_page_number_ = header.first_used_page;
+    file_->scanAhead(current_page_number_);
   }
 
   /**
@@ -55,9 +57,7 @@ class FileIterator {
    * Advances the iterator to the next page in the file.
    */
   inline FileIterator &operator++() {
-    assert(file_ != NULL);
-    const PageHeader &header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    advance();
 
     return *this;
   }
@@ -66,9 +66,7 @@ class FileIterator {
   inline FileIterator operator++(int) {
     FileIterator tmp = *this;  // copy ourselves
 
-    assert(file_ != NULL);
-    const PageHeader &header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    advance();
 
     return tmp;
   }
@@ -80,12 +78,12 @@ class FileIterator {
    * @return    True if other iterator is equal to this one.
    */
   inline bool operator==(const FileIterator &rhs) const {
-    return file_->filename() == rhs.file_->filename() &&
+    return *file_ == *rhs.file_ &&
            current_page_number_ == rhs.current_page_number_;
   }
 
   inline bool operator!=(const FileIterator &rhs) const {
-    return (file_->filename() != rhs.file_->filename()) ||
+    return (*file_ != *rhs.file_) ||
            (current_page_number_ != rhs.current_page_number_);
   }
 
@@ -100,6 +98,22 @@ class FileIterator {
   }
 
  private:
+  /**
+   * Moves to the next used page, asking for the pages ahead to be read in
+   * when that enters another window of File::SCAN_AHEAD_PAGES pages.  Freed
+   * pages are skipped, so the boundary itself may never be visited.
+   */
+  inline void advance() {
+    assert(file_ != NULL);
+    const PageId previous_page_number = current_page_number_;
+    const PageHeader &header = file_->readPageHeader(current_page_number_);
+    current_page_number_ = header.next_page_number;
+    if (current_page_number_ / File::SCAN_AHEAD_PAGES !=
+        previous_page_number / File::SCAN_AHEAD_PAGES) {
+      file_->scanAhead(current_page_number_);
+    }
+  }
+
   /**
    * File we're iterating over.
    */
@@ -0,0 +1,153 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "frame_arena.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * mbind() policy interleaving pages across the nodes of the mask
+ */
+const int MPOL_INTERLEAVE_MODE = 3;
+
+/**
+ * Reads the online NUMA nodes, such as "0-1,3", into a node mask.
+ */
+std::vector<unsigned long> onlineNodes() {
+  std::vector<unsigned long> mask;
+  std::ifstream online("/sys/devices/system/node/online");
+  std::string ranges;
+  if (!std::getline(online, ranges)) {
+    return mask;
+  }
+  std::size_t pos = 0;
+  while (pos < ranges.size()) {
+    std::size_t end = ranges.find(',', pos);
+    if (end == std::string::npos) {
+      end = ranges.size();
+    }
+    const std::string range = ranges.substr(pos, end - pos);
+    const std::size_t dash = range.find('-');
+    const unsigned long first = std::stoul(range.substr(0, dash));
+    const unsigned long last =
+        dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+    for (unsigned long node = first; node <= last; ++node) {
+      const std::size_t word = node / (8 * sizeof(unsigned long));
+      if (mask.size() <= word) {
+        mask.resize(word + 1, 0);
+      }
+      mask[word] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    }
+    pos = end + 1;
+  }
+  return mask;
+}
+
+}  // namespace
+
+FrameArena::FrameArena(const std::uint32_t frames, const PoolMemory &memory)
+    : memory_(memory), huge_pages_(memory.hugePages != HugePages::NONE) {
+  resize(frames);
+}
+
+FrameArena::~FrameArena() {
+  for (const Segment &segment : segments_) {
+    ::munmap(segment.pages, segment.length);
+  }
+}
+
+FrameArena::Segment FrameArena::mapSegment(const std::uint32_t frames) {
+  Segment segment = {nullptr, static_cast<std::size_t>(frames) * Page::SIZE,
+                     frames, 0};
+  void *mapping = MAP_FAILED;
+  bool huge = false;
+  if (memory_.hugePages == HugePages::EXPLICIT) {
+    const std::size_t huge_length =
+        (segment.length + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    mapping = ::mmap(nullptr, huge_length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mapping != MAP_FAILED) {
+      segment.length = huge_length;
+      segment.capacity = huge_length / Page::SIZE;
+      huge = true;
+    }
+  }
+  if (mapping == MAP_FAILED) {
+    mapping = ::mmap(nullptr, segment.length, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    if (memory_.hugePages != HugePages::NONE) {
+      huge = ::madvise(mapping, segment.length, MADV_HUGEPAGE) == 0;
+    }
+  }
+  huge_pages_ = huge_pages_ && huge;
+  segment.pages = static_cast<Page *>(mapping);
+  // Place the memory before it is first touched.
+  if (memory_.numaInterleave) {
+    interleave(mapping, segment.length);
+  }
+  return segment;
+}
+
+void FrameArena::resize(const std::uint32_t frames) {
+  while (frames_.size() > frames) {
+    Segment &segment = segments_.back();
+    const std::uint32_t drop = std::min<std::uint32_t>(
+        segment.used, static_cast<std::uint32_t>(frames_.size() - frames));
+    segment.used -= drop;
+    frames_.resize(frames_.size() - drop);
+    if (segment.used == 0) {
+      ::munmap(segment.pages, segment.length);
+      segments_.pop_back();
+    } else {
+      // Give back the dropped pages but keep their addresses for regrowth.
+      ::madvise(segment.pages + segment.used, drop * Page::SIZE,
+                MADV_DONTNEED);
+    }
+  }
+  while (frames_.size() < frames) {
+    const std::uint32_t wanted = frames - frames_.size();
+    if (segments_.empty() || segments_.back().used == segments_.back().capacity) {
+      segments_.push_back(mapSegment(wanted));
+    }
+    Segment &segment = segments_.back();
+    const std::uint32_t add = std::min(wanted, segment.capacity - segment.used);
+    for (std::uint32_t i = 0; i < add; ++i) {
+      Page *page = segment.pages + segment.used++;
+      new (page) Page();
+      frames_.push_back(page);
+    }
+  }
+}
+
+void FrameArena::interleave(void *start, const std::size_t length) {
+  std::vector<unsigned long> mask = onlineNodes();
+  if (mask.empty()) {
+    return;
+  }
+  // Interleaving is an optimization only, so a kernel without NUMA support
+  // is not an error.
+  ::syscall(SYS_mbind, start, length, MPOL_INTERLEAVE_MODE, mask.data(),
+            mask.size() * 8 * sizeof(unsigned long) + 1, 0);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,175 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Whether the buffer pool is backed by huge pages.
+ */
+enum class HugePages {
+  /**
+   * Regular pages only.
+   */
+  NONE,
+
+  /**
+   * Ask the kernel to back the pool with transparent huge pages.
+   */
+  TRANSPARENT,
+
+  /**
+   * Map the pool from the reserved huge page pool (MAP_HUGETLB), falling
+   * back to regular pages if none are available.
+   */
+  EXPLICIT
+};
+
+/**
+ * @brief How the memory of a buffer pool is allocated.
+ */
+struct PoolMemory {
+  /**
+   * Huge page backing to use
+   */
+  HugePages hugePages = HugePages::NONE;
+
+  /**
+   * Interleave the pool's memory across all online NUMA nodes
+   */
+  bool numaInterleave = false;
+};
+
+/**
+ * @brief Frames of a buffer pool in page-aligned mappings.
+ *
+ * The frames start out in one contiguous mapping; growing the arena maps
+ * another segment, so pages never move.  Huge pages and NUMA interleaving
+ * are best effort: if the kernel refuses them the arena silently uses
+ * regular, locally allocated pages.
+ */
+class FrameArena {
+ public:
+  /**
+   * Maps and initializes the frames.
+   *
+   * @param frames  Number of frames
+   * @param memory  How to allocate them
+   * @throws  std::bad_alloc  If the memory cannot be mapped.
+   */
+  FrameArena(const std::uint32_t frames, const PoolMemory &memory);
+
+  /**
+   * Unmaps the frames.
+   */
+  ~FrameArena();
+
+  FrameArena(const FrameArena &) = delete;
+  FrameArena &operator=(const FrameArena &) = delete;
+
+  /**
+   * Returns the page held in a frame.
+   */
+  Page &operator[](const FrameId frame) { return *frames_[frame]; }
+
+  /**
+   * Returns the page held in a frame.
+   */
+  const Page &operator[](const FrameId frame) const { return *frames_[frame]; }
+
+  /**
+   * Returns the number of frames.
+   */
+  std::uint32_t size() const { return frames_.size(); }
+
+  /**
+   * Changes the number of frames.  Pages of the remaining frames stay where
+   * they are.  Memory of frames dropped from the end is released to the
+   * kernel and reused if the arena grows again.
+   *
+   * @param frames  New number of frames
+   * @throws  std::bad_alloc  If memory for new frames cannot be mapped.
+   */
+  void resize(const std::uint32_t frames);
+
+  /**
+   * Returns true if all frames are mapped from huge pages or advised to be.
+   */
+  bool hugePages() const { return huge_pages_; }
+
+ private:
+  /**
+   * One mapping holding consecutive frames
+   */
+  struct Segment {
+    /**
+     * Start of the mapping
+     */
+    Page *pages;
+
+    /**
+     * Length of the mapping in bytes
+     */
+    std::size_t length;
+
+    /**
+     * Number of frames the mapping has room for
+     */
+    std::uint32_t capacity;
+
+    /**
+     * Number of those frames in use
+     */
+    std::uint32_t used;
+  };
+
+  /**
+   * Size of a huge page, to which explicit huge page mappings are rounded
+   */
+  static const std::size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+  /**
+   * Maps a segment with room for the given number of frames.
+   */
+  Segment mapSegment(const std::uint32_t frames);
+
+  /**
+   * Binds a mapping to all online NUMA nodes, interleaved page by page.
+   */
+  static void interleave(void *start, const std::size_t length);
+
+  /**
+   * How memory is allocated
+   */
+  PoolMemory memory_;
+
+  /**
+   * Mappings, in frame order
+   */
+  std::vector<Segment> segments_;
+
+  /**
+   * Page of each frame
+   */
+  std::vector<Page *> frames_;
+
+  /**
+   * Whether huge pages back every segment
+   */
+  bool huge_pages_;
+};
+
+}  // namespace badgerdb
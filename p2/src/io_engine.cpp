@@ -0,0 +1,402 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "io_engine.h"
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <system_error>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Most threads a ThreadPoolEngine starts, whatever the queue depth
+ */
+const std::uint32_t MAX_THREADS = 8;
+
+/**
+ * Times an IoUringEngine tries to submit its stop marker before giving up
+ */
+const int STOP_ATTEMPTS = 100;
+
+/**
+ * Pause between attempts to submit the stop marker
+ */
+const long STOP_RETRY_NS = 1000 * 1000;
+
+/**
+ * Longest an IoUringEngine's completion thread waits before looking at its
+ * stop flag
+ */
+const long REAP_POLL_NS = 100 * 1000 * 1000;
+
+/**
+ * Number of buffers of a request to transfer in one call.
+ */
+int transferCount(const IoRequest &request) {
+  return static_cast<int>(
+      std::min<std::size_t>(request.buffers.size() - request.next, IOV_MAX));
+}
+
+}  // namespace
+
+//----------------------------------------
+// IoBatch
+//----------------------------------------
+
+void IoBatch::wait() {
+  std::unique_lock<std::mutex> lock(latch);
+  done.wait(lock, [this] { return pending == 0; });
+}
+
+//----------------------------------------
+// IoEngine
+//----------------------------------------
+
+std::unique_ptr<IoEngine> IoEngine::create(const IoEngineKind kind,
+                                           std::uint32_t queueDepth) {
+  queueDepth = std::max<std::uint32_t>(1, queueDepth);
+  if (kind == IoEngineKind::IO_URING) {
+    try {
+      return std::unique_ptr<IoEngine>(new IoUringEngine(queueDepth));
+    } catch (const std::system_error &) {
+      // io_uring is missing or disabled; use threads instead
+    }
+  }
+  return std::unique_ptr<IoEngine>(
+      new ThreadPoolEngine(std::min(queueDepth, MAX_THREADS)));
+}
+
+void IoEngine::submit(const std::vector<IoRequest *> &requests,
+                      IoBatch &batch) {
+  // count them all first, so the batch cannot look finished while some are
+  // still being started
+  {
+    std::lock_guard<std::mutex> guard(batch.latch);
+    batch.pending += requests.size();
+  }
+  for (IoRequest *request : requests) {
+    request->error = 0;
+    request->next = 0;
+    request->batch = &batch;
+  }
+  for (IoRequest *request : requests) {
+    start(request);
+  }
+}
+
+bool IoEngine::advance(IoRequest &request, const long result) {
+  if (result == -EINTR || result == -EAGAIN) {
+    return false;
+  }
+  if (result < 0) {
+    request.error = static_cast<int>(-result);
+    return true;
+  }
+  if (result == 0) {
+    if (request.op == IoOp::WRITE) {
+      request.error = EIO;
+      return true;
+    }
+    // Past the end of the file, which reads as zeroes.
+    for (; request.next < request.buffers.size(); ++request.next) {
+      std::memset(request.buffers[request.next].iov_base, 0,
+                  request.buffers[request.next].iov_len);
+    }
+    return true;
+  }
+  request.offset += result;
+  // Skip the buffers transferred and trim a partly transferred one.
+  std::size_t done = result;
+  while (request.next < request.buffers.size() &&
+         done >= request.buffers[request.next].iov_len) {
+    done -= request.buffers[request.next].iov_len;
+    ++request.next;
+  }
+  if (done > 0) {
+    iovec &buffer = request.buffers[request.next];
+    buffer.iov_base = static_cast<char *>(buffer.iov_base) + done;
+    buffer.iov_len -= done;
+  }
+  return request.next == request.buffers.size();
+}
+
+void IoEngine::complete(IoRequest *request) {
+  IoBatch &batch = *request->batch;
+  // notify while holding the latch: the waiter may destroy the batch as soon
+  // as it can see pending reach 0
+  std::lock_guard<std::mutex> guard(batch.latch);
+  if (--batch.pending == 0) {
+    batch.done.notify_all();
+  }
+}
+
+//----------------------------------------
+// ThreadPoolEngine
+//----------------------------------------
+
+ThreadPoolEngine::ThreadPoolEngine(const std::uint32_t threads)
+    : numThreads(std::max<std::uint32_t>(1, threads)), stopping(false) {}
+
+ThreadPoolEngine::~ThreadPoolEngine() {
+  {
+    std::lock_guard<std::mutex> guard(latch);
+    stopping = true;
+  }
+  queued.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPoolEngine::start(IoRequest *request) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (threads.empty()) {
+    for (std::uint32_t i = 0; i < numThreads; i++) {
+      threads.emplace_back(&ThreadPoolEngine::work, this);
+    }
+  }
+  queue.push_back(request);
+  queued.notify_one();
+}
+
+void ThreadPoolEngine::work() {
+  std::unique_lock<std::mutex> lock(latch);
+  while (true) {
+    queued.wait(lock, [this] { return stopping || !queue.empty(); });
+    if (queue.empty()) {
+      return;
+    }
+    IoRequest *request = queue.front();
+    queue.pop_front();
+    lock.unlock();
+    long result;
+    do {
+      const ssize_t count =
+          request->op == IoOp::READ
+              ? ::preadv(request->fd, &request->buffers[request->next],
+                         transferCount(*request), request->offset)
+              : ::pwritev(request->fd, &request->buffers[request->next],
+                          transferCount(*request), request->offset);
+      result = count < 0 ? -errno : count;
+    } while (!advance(*request, result));
+    complete(request);
+    lock.lock();
+  }
+}
+
+//----------------------------------------
+// IoUringEngine
+//----------------------------------------
+
+IoUringEngine::IoUringEngine(const std::uint32_t queueDepth)
+    : sqRing(MAP_FAILED),
+      cqRing(MAP_FAILED),
+      sqes(MAP_FAILED),
+      inFlight(0),
+      stopRequested(false) {
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ringFd =
+      static_cast<int>(::syscall(__NR_io_uring_setup, queueDepth, &params));
+  if (ringFd < 0) {
+    throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+  }
+  sqRingLength = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingLength = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  timedWait = params.features & IORING_FEAT_EXT_ARG;
+  if (singleMmap) {
+    sqRingLength = cqRingLength = std::max(sqRingLength, cqRingLength);
+  }
+  sqRing = ::mmap(nullptr, sqRingLength, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (sqRing != MAP_FAILED) {
+    cqRing = singleMmap ? sqRing
+                        : ::mmap(nullptr, cqRingLength, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, ringFd,
+                                 IORING_OFF_CQ_RING);
+  }
+  sqesLength = params.sq_entries * sizeof(io_uring_sqe);
+  if (cqRing != MAP_FAILED) {
+    sqes = ::mmap(nullptr, sqesLength, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  }
+  if (sqes == MAP_FAILED) {
+    const int error = errno;
+    if (cqRing != MAP_FAILED && cqRing != sqRing) {
+      ::munmap(cqRing, cqRingLength);
+    }
+    if (sqRing != MAP_FAILED) {
+      ::munmap(sqRing, sqRingLength);
+    }
+    ::close(ringFd);
+    throw std::system_error(error, std::generic_category(), "io_uring mmap");
+  }
+  char *sq = static_cast<char *>(sqRing);
+  sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  char *cq = static_cast<char *>(cqRing);
+  cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = cq + params.cq_off.cqes;
+  // leave room in the completion ring for the stop marker
+  maxInFlight = std::min(params.sq_entries, params.cq_entries - 1);
+  reaper = std::thread(&IoUringEngine::reap, this);
+}
+
+IoUringEngine::~IoUringEngine() {
+  bool pushed = false;
+  for (int attempt = 0; attempt < STOP_ATTEMPTS && !pushed; attempt++) {
+    if (attempt > 0) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(STOP_RETRY_NS));
+    }
+    std::lock_guard<std::mutex> guard(latch);
+    pushed = push(nullptr) == 0;
+  }
+  if (!pushed) {
+    stopRequested = true;
+    if (!timedWait) {
+      // the thread may sleep in the kernel for good; it still uses the ring
+      reaper.detach();
+      return;
+    }
+  }
+  reaper.join();
+  ::munmap(sqes, sqesLength);
+  if (cqRing != sqRing) {
+    ::munmap(cqRing, cqRingLength);
+  }
+  ::munmap(sqRing, sqRingLength);
+  ::close(ringFd);
+}
+
+void IoUringEngine::start(IoRequest *request) {
+  int error;
+  {
+    std::unique_lock<std::mutex> lock(latch);
+    slotFree.wait(lock, [this] { return inFlight < maxInFlight; });
+    error = push(request);
+    if (error == 0) {
+      inFlight++;
+      return;
+    }
+  }
+  request->error = error;
+  complete(request);
+}
+
+int IoUringEngine::push(IoRequest *request) {
+  // the kernel consumes entries during io_uring_enter(), so the ring is
+  // empty whenever the latch is free
+  const unsigned tail = *sqTail;
+  const unsigned index = tail & *sqMask;
+  io_uring_sqe &sqe = static_cast<io_uring_sqe *>(sqes)[index];
+  std::memset(&sqe, 0, sizeof(sqe));
+  if (request == nullptr) {
+    sqe.opcode = IORING_OP_NOP;
+  } else {
+    sqe.opcode =
+        request->op == IoOp::READ ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe.fd = request->fd;
+    sqe.off = request->offset;
+    sqe.addr =
+        reinterpret_cast<std::uint64_t>(&request->buffers[request->next]);
+    sqe.len = transferCount(*request);
+  }
+  sqe.user_data = reinterpret_cast<std::uint64_t>(request);
+  sqArray[index] = index;
+  __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+  while (true) {
+    const long submitted =
+        ::syscall(__NR_io_uring_enter, ringFd, 1, 0, 0, nullptr, 0);
+    if (submitted == 1) {
+      return 0;
+    }
+    if (submitted < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    // the kernel did not take the entry; take it back
+    const int error = submitted < 0 ? errno : EIO;
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+    return error;
+  }
+}
+
+void IoUringEngine::reap() {
+  std::vector<IoRequest *> finished;
+  bool stopping = false;
+  while (!stopping) {
+    unsigned head = *cqHead;
+    const unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      if (stopRequested) {
+        return;
+      }
+      // EINTR and a timeout just mean looking again
+      if (timedWait) {
+        __kernel_timespec timeout = {0, REAP_POLL_NS};
+        io_uring_getevents_arg arg;
+        std::memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<std::uint64_t>(&timeout);
+        ::syscall(__NR_io_uring_enter, ringFd, 0, 1,
+                  IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg,
+                  sizeof(arg));
+      } else {
+        ::syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS,
+                  nullptr, 0);
+      }
+      continue;
+    }
+    {
+      // held across the whole sweep: resubmissions need it anyway, and it
+      // orders this thread after the submitters of the requests it reaps
+      std::lock_guard<std::mutex> guard(latch);
+      for (; head != tail; head++) {
+        const io_uring_cqe &cqe =
+            static_cast<io_uring_cqe *>(cqes)[head & *cqMask];
+        IoRequest *request = reinterpret_cast<IoRequest *>(cqe.user_data);
+        if (request == nullptr) {
+          stopping = true;
+        } else if (advance(*request, cqe.res)) {
+          finished.push_back(request);
+        } else {
+          // a short transfer keeps its slot for the rest
+          const int error = push(request);
+          if (error != 0) {
+            request->error = error;
+            finished.push_back(request);
+          }
+        }
+      }
+      __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+      inFlight -= finished.size();
+    }
+    if (!finished.empty()) {
+      slotFree.notify_all();
+      for (IoRequest *request : finished) {
+        complete(request);
+      }
+      finished.clear();
+    }
+  }
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,376 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace badgerdb {
+
+class IoBatch;
+
+/**
+ * @brief How an IoEngine carries out requests.
+ */
+enum class IoEngineKind {
+  /**
+   * Linux io_uring, falling back to THREAD_POOL if the kernel does not
+   * offer it.
+   */
+  IO_URING,
+
+  /**
+   * Worker threads issuing blocking preadv()/pwritev() calls.
+   */
+  THREAD_POOL
+};
+
+/**
+ * @brief Direction of an IoRequest.
+ */
+enum class IoOp { READ, WRITE };
+
+/**
+ * @brief A vectored read or write of consecutive bytes of a file.
+ *
+ * The request, its buffers and the batch it is submitted with must stay
+ * alive until the batch has been waited for.
+ */
+struct IoRequest {
+  /**
+   * Whether to read or write
+   */
+  IoOp op;
+
+  /**
+   * Descriptor of the file
+   */
+  int fd;
+
+  /**
+   * Offset from the beginning of the file
+   */
+  std::uint64_t offset;
+
+  /**
+   * Buffers to fill or write, in order.  Consumed by the engine.
+   */
+  std::vector<iovec> buffers;
+
+  /**
+   * 0 once the request has completed, or the errno value it failed with.
+   * Bytes read past the end of the file read as zeroes.
+   */
+  int error = 0;
+
+  /**
+   * First buffer not yet completely transferred; managed by the engine
+   */
+  std::size_t next = 0;
+
+  /**
+   * Batch the request was submitted with; managed by the engine
+   */
+  IoBatch *batch = nullptr;
+};
+
+/**
+ * @brief A group of requests that can be waited for together.
+ */
+class IoBatch {
+ public:
+  /**
+   * Constructor of IoBatch class
+   */
+  IoBatch() : pending(0) {}
+
+  IoBatch(const IoBatch &) = delete;
+  IoBatch &operator=(const IoBatch &) = delete;
+
+  /**
+   * Blocks until every request submitted with the batch has completed.
+   */
+  void wait();
+
+ private:
+  friend class IoEngine;
+
+  /**
+   * Number of requests submitted and not yet completed
+   */
+  std::size_t pending;
+
+  /**
+   * Protects pending
+   */
+  std::mutex latch;
+
+  /**
+   * Signalled when pending drops to 0
+   */
+  std::condition_variable done;
+};
+
+/**
+ * @brief Carries out page reads and writes asynchronously, keeping several
+ *        in flight at once.
+ *
+ * Requests are submitted in batches and complete in any order; the caller
+ * waits for a batch rather than for each request, so a device that serves
+ * requests in parallel gets a queue depth above one.  An engine may be used
+ * from several threads at once.
+ */
+class IoEngine {
+ public:
+  /**
+   * Creates an engine.
+   *
+   * @param kind        Preferred implementation
+   * @param queueDepth  Most requests to keep in flight at once
+   * @return  The engine; see kind() for the implementation chosen.
+   */
+  static std::unique_ptr<IoEngine> create(
+      const IoEngineKind kind = IoEngineKind::IO_URING,
+      const std::uint32_t queueDepth = 32);
+
+  /**
+   * Waits for nothing: every batch must have been waited for already.
+   */
+  virtual ~IoEngine() {}
+
+  /**
+   * Starts requests and returns without waiting for them.
+   *
+   * @param requests  Requests to start
+   * @param batch     Batch to count the requests in
+   */
+  void submit(const std::vector<IoRequest *> &requests, IoBatch &batch);
+
+  /**
+   * Returns the implementation in use.
+   */
+  virtual IoEngineKind kind() const = 0;
+
+ protected:
+  /**
+   * Starts one request or what is left of it.
+   *
+   * @param request Request to start
+   */
+  virtual void start(IoRequest *request) = 0;
+
+  /**
+   * Accounts for the result of a transfer for a request.
+   *
+   * @param request Request transferred for
+   * @param result  Bytes transferred, or a negated errno value
+   * @return  True if the request is finished, false if the rest of it must
+   * be started again
+   */
+  static bool advance(IoRequest &request, const long result);
+
+  /**
+   * Marks a finished request as completed in its batch.
+   *
+   * @param request Finished request
+   */
+  static void complete(IoRequest *request);
+};
+
+/**
+ * @brief IoEngine using a pool of threads that issue blocking calls.
+ *
+ * The threads are started on first use.
+ */
+class ThreadPoolEngine : public IoEngine {
+ public:
+  /**
+   * Constructor of ThreadPoolEngine class
+   *
+   * @param threads Number of threads, and so of requests in flight
+   */
+  explicit ThreadPoolEngine(const std::uint32_t threads);
+
+  /**
+   * Stops the threads.
+   */
+  ~ThreadPoolEngine();
+
+  IoEngineKind kind() const override { return IoEngineKind::THREAD_POOL; }
+
+ protected:
+  void start(IoRequest *request) override;
+
+ private:
+  /**
+   * Carries out queued requests until stopped.
+   */
+  void work();
+
+  /**
+   * Number of threads to start
+   */
+  const std::uint32_t numThreads;
+
+  /**
+   * Requests waiting for a thread
+   */
+  std::deque<IoRequest *> queue;
+
+  /**
+   * Set to make the threads exit
+   */
+  bool stopping;
+
+  /**
+   * Protects queue, stopping and threads
+   */
+  std::mutex latch;
+
+  /**
+   * Signalled when a request is queued or the threads are to stop
+   */
+  std::condition_variable queued;
+
+  /**
+   * The worker threads
+   */
+  std::vector<std::thread> threads;
+};
+
+/**
+ * @brief IoEngine submitting to a Linux io_uring.
+ *
+ * Requests are placed on the submission ring under a latch; a completion
+ * thread reaps the completion ring, restarting short transfers.
+ */
+class IoUringEngine : public IoEngine {
+ public:
+  /**
+   * Sets up the ring and starts the completion thread.
+   *
+   * @param queueDepth  Most requests in flight at once
+   * @throws  std::system_error If the kernel does not offer io_uring.
+   */
+  explicit IoUringEngine(const std::uint32_t queueDepth);
+
+  /**
+   * Stops the completion thread and tears down the ring.  If the kernel
+   * keeps refusing the stop marker, the thread is told to stop by a flag it
+   * polls instead; if it cannot poll, it is left running and the ring is
+   * leaked rather than waited for forever.
+   */
+  ~IoUringEngine();
+
+  IoEngineKind kind() const override { return IoEngineKind::IO_URING; }
+
+ protected:
+  void start(IoRequest *request) override;
+
+ private:
+  /**
+   * Places one operation on the submission ring and hands it to the kernel.
+   * The caller must hold latch.
+   *
+   * @param request Request to transfer for, or null for the stop marker
+   * @return  0, or the errno value the kernel refused it with
+   */
+  int push(IoRequest *request);
+
+  /**
+   * Reaps completions until the stop marker completes.
+   */
+  void reap();
+
+  /**
+   * Descriptor of the ring
+   */
+  int ringFd;
+
+  /**
+   * Mapping of the submission ring, and its length
+   */
+  void *sqRing;
+  std::size_t sqRingLength;
+
+  /**
+   * Mapping of the completion ring, and its length; the same as the
+   * submission ring's if the kernel maps them together
+   */
+  void *cqRing;
+  std::size_t cqRingLength;
+
+  /**
+   * Mapping of the submission queue entries, and its length
+   */
+  void *sqes;
+  std::size_t sqesLength;
+
+  /**
+   * Fields of the submission ring
+   */
+  unsigned *sqTail;
+  unsigned *sqMask;
+  unsigned *sqArray;
+
+  /**
+   * Fields of the completion ring
+   */
+  unsigned *cqHead;
+  unsigned *cqTail;
+  unsigned *cqMask;
+  void *cqes;
+
+  /**
+   * Most requests in flight, within the capacity of the completion ring
+   */
+  std::uint32_t maxInFlight;
+
+  /**
+   * Requests started and not yet completed
+   */
+  std::uint32_t inFlight;
+
+  /**
+   * Whether the kernel can time out waits for completions, letting reap()
+   * poll stopRequested
+   */
+  bool timedWait;
+
+  /**
+   * Set to stop reap() when the stop marker cannot be submitted
+   */
+  std::atomic<bool> stopRequested;
+
+  /**
+   * Serializes use of the submission ring and protects inFlight
+   */
+  std::mutex latch;
+
+  /**
+   * Signalled when a request completes
+   */
+  std::condition_variable slotFree;
+
+  /**
+   * Thread running reap()
+   */
+  std::thread reaper;
+};
+
+}  // namespace badgerdb
@@ -1,17 +1,26 @@
+#include <fcntl.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <iostream> 
 #include <stdio.h>
+#include <chrono>
 #include <cstring>
+#include <fstream>
 #include <memory>
 #include <optional>
+#include <thread>
+#include <vector>
 
 #include "buffer.h"
+#include "exceptions/bad_file_format_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/file_open_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
+#include "exceptions/read_only_file_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 #include "page_iterator.h"
@@ -40,6 +49,27 @@ void test3(File &file4);
 void test4(File &file4);
 void test5(File &file4);
 void test6(File &file1);
+void test7(File &file1);
+void test8(const std::string &filename1);
+void test9(const std::string &filename1);
+void test10(const std::string &filename1);
+void test11(const std::string &filename1);
+void test12(const std::string &filename1);
+void test13(const std::string &filename1);
+void test14(const std::string &filename1);
+void test15(const std::string &filename1);
+void test16(const std::string &filename1);
+void test17(const std::string &filename1);
+void test18(const std::string &filename1);
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
 // Calls the above tests
 void testBufMgr();
 
@@ -150,12 +180,56 @@ void testBufMgr() {
     test5(file5);
     std::cout <<"test6\n";
     test6(file1);
+    std::cout <<"test7\n";
+    test7(file1);
 
     // Close the files by going out of scope
   }
 
-  // Delete files
   bufMgr = nullptr;
+  // All handles are closed now, so this reopens file1 from disk
+  std::cout <<"test8\n";
+  test8(filename1);
+  std::cout <<"test9\n";
+  test9(filename1);
+  std::cout <<"test10\n";
+  test10(filename1);
+  std::cout <<"test11\n";
+  test11(filename1);
+  std::cout <<"test12\n";
+  test12(filename1);
+  std::cout <<"test13\n";
+  test13(filename1);
+  std::cout <<"test14\n";
+  test14(filename1);
+  std::cout <<"test15\n";
+  test15(filename1);
+  std::cout <<"test16\n";
+  test16(filename1);
+  std::cout <<"test17\n";
+  test17(filename1);
+  std::cout <<"test18\n";
+  test18(filename1);
+  std::cout <<"test19\n";
+  test19();
+  std::cout <<"test20\n";
+  test20();
+  std::cout <<"test21\n";
+  test21();
+  std::cout <<"test22\n";
+  test22();
+  std::cout <<"test23\n";
+  test23();
+  std::cout <<"test24\n";
+  test24();
+  std::cout <<"test25\n";
+  test25();
+  std::cout <<"test26\n";
+  test26();
+  std::cout <<"test27\n";
+  test27();
+
+  // Delete files
   File::remove(filename1);
   File::remove(filename2);
   File::remove(filename3);
@@ -308,3 +382,1171 @@ void test6(File &file1) {
 
   //bufMgr->flushFile(file1);
 }
+
+void test7(File &file1) {
+  // Several threads reading and unpinning pages of the same file at once.
+  // Every page of file1 holds one record starting with its page number.
+  const int numThreads = 4;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < numThreads; t++) {
+    threads.emplace_back([&file1, t]() {
+      char buf[100];
+      Page *threadPage;
+      for (PageId k = 0; k < 4 * num; k++) {
+        const PageId pageNo = (k * 7 + t) % num + 1;
+        bufMgr->readPage(file1, pageNo, threadPage);
+        sprintf(buf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+        if (threadPage->getRecordView({pageNo, 1}).compare(0, strlen(buf),
+                                                           buf) != 0) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+        bufMgr->unPinPage(file1, pageNo, false);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  std::cout << "Test 7 passed"
+            << "\n";
+}
+
+void test8(const std::string &filename1) {
+  // The header cached while file1 was open must have been written back when
+  // its last handle was closed.  Reopen it through the fstream fallback.
+  File file1 = File::open(filename1, FileBackend::STREAM);
+  PageId pageCount = 0;
+  for (FileIterator iter = file1.begin(); iter != file1.end(); ++iter) {
+    pageCount++;
+  }
+  if (pageCount != num) {
+    PRINT_ERROR("ERROR :: File header was not written back on close");
+  }
+
+  std::cout << "Test 8 passed"
+            << "\n";
+}
+
+void test9(const std::string &filename1) {
+  // A hot set read twice must survive a scan of the rest of file1 under the
+  // scan-resistant replacement policies.
+  const PageId hot = 10;
+  File file1 = File::open(filename1);
+  for (Replacement replacement : {Replacement::LRU_K, Replacement::TWO_Q}) {
+    BufMgr scanBufMgr(2 * hot, replacement);
+    for (int round = 0; round < 2; round++) {
+      for (PageId pageNo = 1; pageNo <= hot; pageNo++) {
+        scanBufMgr.readPage(file1, pageNo, page);
+        scanBufMgr.unPinPage(file1, pageNo, false);
+      }
+    }
+    for (PageId pageNo = hot + 1; pageNo <= num; pageNo++) {
+      scanBufMgr.readPage(file1, pageNo, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+      if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf),
+                                                   tmpbuf) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      scanBufMgr.unPinPage(file1, pageNo, false);
+    }
+    scanBufMgr.clearBufStats();
+    for (PageId pageNo = 1; pageNo <= hot; pageNo++) {
+      scanBufMgr.readPage(file1, pageNo, page);
+      scanBufMgr.unPinPage(file1, pageNo, false);
+    }
+    if (scanBufMgr.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: Scan evicted the hot set");
+    }
+  }
+
+  std::cout << "Test 9 passed"
+            << "\n";
+}
+
+void test10(const std::string &filename1) {
+  // Clock alone lets a scan flush the hot set; reading the scan with the
+  // SEQUENTIAL hint must confine it to the scan ring instead.
+  const PageId hot = 10;
+  File file1 = File::open(filename1);
+  BufMgr scanBufMgr(2 * hot);
+  for (PageId pageNo = 1; pageNo <= hot; pageNo++) {
+    scanBufMgr.readPage(file1, pageNo, page);
+    scanBufMgr.unPinPage(file1, pageNo, false);
+  }
+  for (AccessHint hint : {AccessHint::SEQUENTIAL, AccessHint::ONE_SHOT}) {
+    for (PageId pageNo = hot + 1; pageNo <= num; pageNo++) {
+      scanBufMgr.readPage(file1, pageNo, page, hint);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+      if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf),
+                                                   tmpbuf) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      scanBufMgr.unPinPage(file1, pageNo, false);
+    }
+    if (hint == AccessHint::SEQUENTIAL) {
+      scanBufMgr.clearBufStats();
+      for (PageId pageNo = 1; pageNo <= hot; pageNo++) {
+        scanBufMgr.readPage(file1, pageNo, page);
+        scanBufMgr.unPinPage(file1, pageNo, false);
+      }
+      if (scanBufMgr.getBufStats().diskreads != 0) {
+        PRINT_ERROR("ERROR :: Sequential scan evicted the hot set");
+      }
+    }
+  }
+
+  std::cout << "Test 10 passed"
+            << "\n";
+}
+
+void test11(const std::string &filename1) {
+  File file1 = File::open(filename1);
+  BufMgr prefetchBufMgr(num);
+  // Explicitly prefetched pages are served without waiting for the disk.
+  const PageId run = 20;
+  prefetchBufMgr.prefetch(file1, 1, run);
+  prefetchBufMgr.waitForPrefetch();
+  prefetchBufMgr.clearBufStats();
+  for (PageId pageNo = 1; pageNo <= run; pageNo++) {
+    prefetchBufMgr.readPage(file1, pageNo, page);
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+    if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf), tmpbuf) !=
+        0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    prefetchBufMgr.unPinPage(file1, pageNo, false);
+  }
+  if (prefetchBufMgr.getBufStats().diskreads != 0 ||
+      prefetchBufMgr.getBufStats().prefetchhits != (int)run) {
+    PRINT_ERROR("ERROR :: Prefetched pages were read again");
+  }
+
+  // Reading page after page keeps the following pages read ahead.
+  const PageId window = 4;
+  prefetchBufMgr.setReadAhead(window);
+  for (PageId pageNo = run + 1; pageNo <= 2 * run; pageNo++) {
+    prefetchBufMgr.readPage(file1, pageNo, page);
+    prefetchBufMgr.unPinPage(file1, pageNo, false);
+  }
+  prefetchBufMgr.waitForPrefetch();
+  prefetchBufMgr.clearBufStats();
+  for (PageId pageNo = 2 * run + 1; pageNo <= 2 * run + window; pageNo++) {
+    prefetchBufMgr.readPage(file1, pageNo, page);
+    prefetchBufMgr.unPinPage(file1, pageNo, false);
+  }
+  if (prefetchBufMgr.getBufStats().diskreads != 0) {
+    PRINT_ERROR("ERROR :: Sequential reads were not read ahead");
+  }
+  prefetchBufMgr.flushFile(file1);
+
+  std::cout << "Test 11 passed"
+            << "\n";
+}
+
+void test12(const std::string &filename1) {
+  // The background writer cleans dirty unpinned pages, so flushing the file
+  // afterwards has nothing left to write.
+  const PageId dirtyPages = 20;
+  File file1 = File::open(filename1);
+  BufMgr writerBufMgr(num);
+  writerBufMgr.startBackgroundWriter(1.0, 1000);
+  for (PageId pageNo = 1; pageNo <= dirtyPages; pageNo++) {
+    writerBufMgr.readPage(file1, pageNo, page);
+    writerBufMgr.unPinPage(file1, pageNo, true);
+  }
+  for (int wait = 0; wait < 50 && writerBufMgr.getBufStats().backgroundwrites <
+                                      (int)dirtyPages;
+       wait++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  writerBufMgr.stopBackgroundWriter();
+  if (writerBufMgr.getBufStats().backgroundwrites != (int)dirtyPages) {
+    PRINT_ERROR("ERROR :: Background writer did not clean the dirty pages");
+  }
+  writerBufMgr.flushFile(file1);
+  if (writerBufMgr.getBufStats().diskwrites != (int)dirtyPages) {
+    PRINT_ERROR("ERROR :: Cleaned pages were written again");
+  }
+  // Starting and stopping from several threads at once leaves at most one
+  // writer running, and none after the last stop.
+  std::vector<std::thread> controllers;
+  for (int k = 0; k < 4; k++) {
+    controllers.emplace_back([&writerBufMgr] {
+      for (int round = 0; round < 20; round++) {
+        writerBufMgr.startBackgroundWriter(1.0, 1000);
+        writerBufMgr.stopBackgroundWriter();
+      }
+    });
+  }
+  for (std::thread &controller : controllers) {
+    controller.join();
+  }
+
+  std::cout << "Test 12 passed"
+            << "\n";
+}
+
+void test13(const std::string &filename1) {
+  File file1 = File::open(filename1);
+  BufMgr batchBufMgr(num);
+  // Out of order, with a duplicate: the seven distinct pages form three runs.
+  std::vector<PageRequest> requests;
+  for (PageId pageNo : {5, 3, 50, 4, 52, 51, 4, 90}) {
+    requests.push_back({&file1, pageNo, nullptr});
+  }
+  batchBufMgr.readPages(requests);
+  for (const PageRequest &request : requests) {
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", request.pageNo,
+            (float)request.pageNo);
+    if (request.page == nullptr ||
+        request.page->getRecordView({request.pageNo, 1})
+                .compare(0, strlen(tmpbuf), tmpbuf) != 0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+  if (batchBufMgr.getBufStats().diskreads != 7 ||
+      batchBufMgr.getBufStats().accesses != (int)requests.size()) {
+    PRINT_ERROR("ERROR :: Batch read the wrong number of pages");
+  }
+  // Every request holds its own pin, so the file cannot be flushed yet.
+  batchBufMgr.unPinPage(file1, 4, false);
+  try {
+    batchBufMgr.flushFile(file1);
+    PRINT_ERROR("ERROR :: Duplicate request was not pinned twice");
+  } catch (const PagePinnedException &e) {
+  }
+  requests.erase(requests.begin() + 3);
+  batchBufMgr.unPinPages(requests, false);
+
+  // A batch with a page that does not exist leaves nothing pinned.
+  std::vector<PageRequest> badRequests = {{&file1, 1, nullptr},
+                                          {&file1, num + 5, nullptr}};
+  try {
+    batchBufMgr.readPages(badRequests);
+    PRINT_ERROR("ERROR :: Batch read a page that does not exist");
+  } catch (const InvalidPageException &e) {
+  }
+  batchBufMgr.flushFile(file1);
+
+  std::cout << "Test 13 passed"
+            << "\n";
+}
+
+void test14(const std::string &filename1) {
+  // A run of pages written with one vectored write reads back page by page,
+  // through both backends.
+  const PageId run = 8;
+  for (FileBackend backend : {FileBackend::POSIX, FileBackend::STREAM}) {
+    std::vector<Page> pages;
+    std::vector<RecordId> runRids;
+    {
+      File file1 = File::open(filename1, backend);
+      std::vector<const Page *> pagePtrs;
+      for (PageId pageNo = 1; pageNo <= run; pageNo++) {
+        pages.push_back(file1.readPage(pageNo));
+      }
+      for (Page &runPage : pages) {
+        sprintf(tmpbuf, "run record %u", runPage.page_number());
+        runRids.push_back(runPage.insertRecord(tmpbuf));
+        pagePtrs.push_back(&runPage);
+      }
+      file1.writePages(1, pagePtrs);
+    }
+    File file1 = File::open(filename1, backend);
+    for (PageId pageNo = 1; pageNo <= run; pageNo++) {
+      sprintf(tmpbuf, "run record %u", pageNo);
+      if (file1.readPage(pageNo).getRecord(runRids[pageNo - 1]) != tmpbuf) {
+        PRINT_ERROR("ERROR :: Vectored write did not match");
+      }
+    }
+  }
+
+  std::cout << "Test 14 passed"
+            << "\n";
+}
+
+void test15(const std::string &filename1) {
+  // Dirty pages dirtied out of order are written back as two runs.
+  File file1 = File::open(filename1);
+  BufMgr flushBufMgr(num);
+  for (PageId pageNo : {7, 3, 20, 5, 4, 6}) {
+    flushBufMgr.readPage(file1, pageNo, page);
+    flushBufMgr.unPinPage(file1, pageNo, true);
+  }
+  flushBufMgr.readPage(file1, 8, page);
+  flushBufMgr.unPinPage(file1, 8, false);
+  const FlushReport report = flushBufMgr.flushFile(file1);
+  if (report.pages != 6 || report.writes != 2 ||
+      report.bytes != 6 * Page::SIZE) {
+    PRINT_ERROR("ERROR :: Flush did not coalesce the dirty pages");
+  }
+  for (PageId pageNo : {3, 4, 5, 6, 7, 8, 20}) {
+    flushBufMgr.readPage(file1, pageNo, page);
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+    if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf), tmpbuf) !=
+        0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    flushBufMgr.unPinPage(file1, pageNo, false);
+  }
+
+  std::cout << "Test 15 passed"
+            << "\n";
+}
+
+void test16(const std::string &filename1) {
+  // Pools mapped with huge pages or interleaved across NUMA nodes work like
+  // any other, whether or not the kernel grants the request.
+  File file1 = File::open(filename1);
+  for (HugePages hugePages :
+       {HugePages::NONE, HugePages::TRANSPARENT, HugePages::EXPLICIT}) {
+    PoolMemory memory;
+    memory.hugePages = hugePages;
+    memory.numaInterleave = hugePages != HugePages::NONE;
+    BufMgr arenaBufMgr(num / 2, Replacement::CLOCK, memory);
+    for (PageId pageNo = 1; pageNo <= num; pageNo++) {
+      arenaBufMgr.readPage(file1, pageNo, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+      if (reinterpret_cast<std::uintptr_t>(page) % alignof(Page) != 0 ||
+          page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf),
+                                                   tmpbuf) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      arenaBufMgr.unPinPage(file1, pageNo, false);
+    }
+  }
+
+  std::cout << "Test 16 passed"
+            << "\n";
+}
+
+void test17(const std::string &filename1) {
+  // Growing the pool keeps the cached pages; shrinking it moves the pages in
+  // the frames removed into free frames and writes back and drops the rest,
+  // unless one of them is pinned.
+  File file1 = File::open(filename1);
+  BufMgr resizeBufMgr(num / 2);
+  for (PageId pageNo = 1; pageNo <= num / 2; pageNo++) {
+    resizeBufMgr.readPage(file1, pageNo, page);
+    resizeBufMgr.unPinPage(file1, pageNo, false);
+  }
+  resizeBufMgr.resize(num);
+  resizeBufMgr.clearBufStats();
+  for (PageId pageNo = 1; pageNo <= num; pageNo++) {
+    resizeBufMgr.readPage(file1, pageNo, page);
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+    if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf), tmpbuf) !=
+        0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    resizeBufMgr.unPinPage(file1, pageNo, pageNo > num / 2);
+  }
+  if (resizeBufMgr.size() != num ||
+      resizeBufMgr.getBufStats().diskreads != (int)(num - num / 2)) {
+    PRINT_ERROR("ERROR :: Growing the pool lost cached pages");
+  }
+
+  resizeBufMgr.readPage(file1, num, page);
+  try {
+    resizeBufMgr.resize(10);
+    PRINT_ERROR(
+        "ERROR :: Pinned page in a removed frame. Exception should have "
+        "been thrown before execution reaches this point.");
+  } catch (const PagePinnedException &e) {
+  }
+  resizeBufMgr.unPinPage(file1, num, false);
+  resizeBufMgr.clearBufStats();
+  resizeBufMgr.resize(10);
+  if (resizeBufMgr.size() != 10 ||
+      resizeBufMgr.getBufStats().diskwrites != (int)(num - num / 2)) {
+    PRINT_ERROR("ERROR :: Shrinking the pool did not write back its pages");
+  }
+  for (PageId pageNo = 1; pageNo <= num; pageNo++) {
+    resizeBufMgr.readPage(file1, pageNo, page);
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+    if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf), tmpbuf) !=
+        0) {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    resizeBufMgr.unPinPage(file1, pageNo, false);
+  }
+
+  // With page 1 pinned in frame 0 and frames 1-4 freed, shrinking to five
+  // frames moves four of the pages in frames 5-9 down, dirty as they are,
+  // and drops only the fifth.
+  const std::string filename = "test.13";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  {
+    File file13 = File::create(filename);
+    for (PageId k = 0; k < 4; k++) {
+      file13.allocatePage();
+    }
+    BufMgr shrinkBufMgr(10);
+    Page *pinned;
+    shrinkBufMgr.readPage(file1, 1, pinned);
+    for (PageId pageNo = 1; pageNo <= 4; pageNo++) {
+      shrinkBufMgr.readPage(file13, pageNo, page);
+      shrinkBufMgr.unPinPage(file13, pageNo, false);
+    }
+    for (PageId pageNo = 6; pageNo <= 10; pageNo++) {
+      shrinkBufMgr.readPage(file1, pageNo, page);
+      shrinkBufMgr.unPinPage(file1, pageNo, true);
+    }
+    shrinkBufMgr.flushFile(file13);
+    shrinkBufMgr.clearBufStats();
+    shrinkBufMgr.resize(5);
+    if (shrinkBufMgr.size() != 5 ||
+        shrinkBufMgr.getBufStats().diskwrites != 1) {
+      PRINT_ERROR("ERROR :: Shrinking dropped pages that fit in free frames");
+    }
+    sprintf(tmpbuf, "test.1 Page %u %7.1f", 1, (float)1);
+    if (pinned->getRecordView({1, 1}).compare(0, strlen(tmpbuf), tmpbuf) !=
+        0) {
+      PRINT_ERROR("ERROR :: Pinned page moved");
+    }
+    shrinkBufMgr.unPinPage(file1, 1, false);
+    shrinkBufMgr.clearBufStats();
+    for (PageId pageNo = 6; pageNo <= 10; pageNo++) {
+      shrinkBufMgr.readPage(file1, pageNo, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+      if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf),
+                                                   tmpbuf) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      shrinkBufMgr.unPinPage(file1, pageNo, false);
+    }
+    if (shrinkBufMgr.getBufStats().diskreads != 1) {
+      PRINT_ERROR("ERROR :: Moved pages were not kept resident");
+    }
+    shrinkBufMgr.flushFile(file1);
+    if (shrinkBufMgr.getBufStats().diskwrites != 4) {
+      PRINT_ERROR("ERROR :: Moved pages were not kept dirty");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 17 passed"
+            << "\n";
+}
+
+void test18(const std::string &filename1) {
+  // Batched reads, read-ahead and flushes behave the same on either engine,
+  // with several runs in flight at once.
+  File file1 = File::open(filename1);
+  for (IoEngineKind engine : {IoEngineKind::IO_URING, IoEngineKind::THREAD_POOL}) {
+    BufMgr ioBufMgr(num, Replacement::CLOCK, PoolMemory(), engine);
+    if (engine == IoEngineKind::THREAD_POOL &&
+        ioBufMgr.getIoEngineKind() != IoEngineKind::THREAD_POOL) {
+      PRINT_ERROR("ERROR :: Wrong I/O engine");
+    }
+    std::vector<PageRequest> requests;
+    for (PageId pageNo : {2, 3, 4, 10, 11, 30, 60, 61, 62, 63}) {
+      requests.push_back({&file1, pageNo, nullptr});
+    }
+    ioBufMgr.readPages(requests);
+    for (const PageRequest &request : requests) {
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", request.pageNo,
+              (float)request.pageNo);
+      if (request.page->getRecordView({request.pageNo, 1})
+              .compare(0, strlen(tmpbuf), tmpbuf) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+    ioBufMgr.unPinPages(requests, true);
+    const FlushReport report = ioBufMgr.flushFile(file1);
+    if (report.pages != requests.size() || report.writes != 4) {
+      PRINT_ERROR("ERROR :: Flush did not write the runs");
+    }
+
+    ioBufMgr.prefetch(file1, 1, num);
+    ioBufMgr.waitForPrefetch();
+    ioBufMgr.clearBufStats();
+    for (PageId pageNo = 1; pageNo <= num; pageNo++) {
+      ioBufMgr.readPage(file1, pageNo, page);
+      sprintf(tmpbuf, "test.1 Page %u %7.1f", pageNo, (float)pageNo);
+      if (page->getRecordView({pageNo, 1}).compare(0, strlen(tmpbuf),
+                                                   tmpbuf) != 0) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      ioBufMgr.unPinPage(file1, pageNo, false);
+    }
+    if (ioBufMgr.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: Prefetched pages were read again");
+    }
+  }
+
+  std::cout << "Test 18 passed"
+            << "\n";
+}
+
+void test19() {
+  // Pages written through O_DIRECT read back the same through the other
+  // backends, whether or not the layout puts them on block boundaries.
+  const std::string filename = "test.6";
+  for (FileFormat format : {FileFormat::LEGACY, FileFormat::V2}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+    {
+      File file6 = File::create(filename, FileBackend::DIRECT, format);
+      BufMgr directBufMgr(num / 4);
+      for (i = 0; i < num; i++) {
+        directBufMgr.allocPage(file6, pid[i], page);
+        sprintf(tmpbuf, "test.6 Page %u %7.1f", pid[i], (float)pid[i]);
+        rid[i] = page->insertRecord(tmpbuf);
+        directBufMgr.unPinPage(file6, pid[i], true);
+      }
+      directBufMgr.flushFile(file6);
+      std::vector<PageRequest> requests;
+      for (PageId pageNo : {1, 2, 3, 50, 51, 99, 100}) {
+        requests.push_back({&file6, pageNo, nullptr});
+      }
+      directBufMgr.readPages(requests);
+      for (const PageRequest &request : requests) {
+        sprintf(tmpbuf, "test.6 Page %u %7.1f", request.pageNo,
+                (float)request.pageNo);
+        if (request.page->getRecordView({request.pageNo, 1})
+                .compare(0, strlen(tmpbuf), tmpbuf) != 0) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      directBufMgr.unPinPages(requests, false);
+    }
+    {
+      File file6 = File::open(filename, FileBackend::STREAM);
+      PageId pageCount = 0;
+      for (FileIterator iter = file6.begin(); iter != file6.end(); ++iter) {
+        const PageId pageNo = (*iter).page_number();
+        sprintf(tmpbuf, "test.6 Page %u %7.1f", pageNo, (float)pageNo);
+        if ((*iter).getRecord({pageNo, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+        pageCount++;
+      }
+      if (pageCount != num) {
+        PRINT_ERROR("ERROR :: Pages written through O_DIRECT were lost");
+      }
+    }
+    File::remove(filename);
+  }
+
+  std::cout << "Test 19 passed"
+            << "\n";
+}
+
+void test20() {
+  // A file in the old layout converts to the block-aligned one with its
+  // pages, page numbers and free list intact, and a corrupt header slot is
+  // refused.
+  const std::string filename = "test.7";
+  const PageId pages = 10;
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  {
+    File file7 = File::create(filename, FileBackend::POSIX, FileFormat::LEGACY);
+    for (PageId k = 0; k < pages; k++) {
+      Page newPage = file7.allocatePage();
+      sprintf(tmpbuf, "test.7 Page %u", newPage.page_number());
+      newPage.insertRecord(tmpbuf);
+      file7.writePage(newPage);
+    }
+    file7.deletePage(4);
+    try {
+      File::convert(filename, FileFormat::V2);
+      PRINT_ERROR(
+          "ERROR :: File is open. Exception should have been thrown "
+          "before execution reaches this point.");
+    } catch (const FileOpenException &e) {
+    }
+  }
+  File::convert(filename, FileFormat::V2);
+  {
+    File file7 = File::open(filename);
+    PageId pageCount = 0;
+    for (FileIterator iter = file7.begin(); iter != file7.end(); ++iter) {
+      const PageId pageNo = (*iter).page_number();
+      sprintf(tmpbuf, "test.7 Page %u", pageNo);
+      if (pageNo == 4 || (*iter).getRecord({pageNo, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      pageCount++;
+    }
+    std::ifstream raw(filename, std::ios::binary | std::ios::ate);
+    if (file7.format() != FileFormat::V2 || pageCount != pages - 1 ||
+        (std::size_t)raw.tellg() != (pages + 1) * Page::SIZE) {
+      PRINT_ERROR("ERROR :: File was not converted");
+    }
+    // the deleted page is reused from the converted free list
+    if (file7.allocatePage().page_number() != 4) {
+      PRINT_ERROR("ERROR :: Free list was not converted");
+    }
+    // page 0 is the header slot, never a page
+    try {
+      file7.readPage(0);
+      PRINT_ERROR(
+          "ERROR :: Page 0 is the header. Exception should have been thrown "
+          "before execution reaches this point.");
+    } catch (const InvalidPageException &e) {
+    }
+    BufMgr headerBufMgr(4);
+    try {
+      headerBufMgr.readPage(file7, 0, page);
+      PRINT_ERROR(
+          "ERROR :: Page 0 is the header. Exception should have been thrown "
+          "before execution reaches this point.");
+    } catch (const InvalidPageException &e) {
+    }
+  }
+  {
+    std::fstream raw(filename, std::ios::binary | std::ios::in | std::ios::out);
+    raw.seekp(sizeof(FormatHeader) + 100);
+    raw.put('x');
+  }
+  try {
+    File::open(filename);
+    PRINT_ERROR(
+        "ERROR :: Header slot is corrupt. Exception should have been thrown "
+        "before execution reaches this point.");
+  } catch (const BadFileFormatException &e) {
+  }
+  File::remove(filename);
+  // a legacy file holding only its header is shorter than the header slot
+  File::create(filename, FileBackend::STREAM, FileFormat::LEGACY);
+  {
+    File file7 = File::open(filename, FileBackend::STREAM);
+    Page newPage = file7.allocatePage();
+    newPage.insertRecord("test.7 short file");
+    file7.writePage(newPage);
+    if (file7.format() != FileFormat::LEGACY ||
+        file7.readPage(newPage.page_number()).getRecord(
+            {newPage.page_number(), 1}) != "test.7 short file") {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 20 passed"
+            << "\n";
+}
+
+void test21() {
+  // A mapped file reads the same through File, FileIterator, BufMgr and its
+  // in-place pages, in both layouts, and refuses to be written.
+  const std::string filename = "test.8";
+  for (FileFormat format : {FileFormat::LEGACY, FileFormat::V2}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+    {
+      File file8 = File::create(filename, FileBackend::POSIX, format);
+      for (i = 0; i < num; i++) {
+        Page newPage = file8.allocatePage();
+        sprintf(tmpbuf, "test.8 Page %u", newPage.page_number());
+        newPage.insertRecord(tmpbuf);
+        file8.writePage(newPage);
+      }
+      file8.deletePage(7);
+    }
+    {
+      File file8 = File::open(filename, FileBackend::MMAP);
+      PageId pageCount = 0;
+      for (FileIterator iter = file8.begin(); iter != file8.end(); ++iter) {
+        const PageId pageNo = (*iter).page_number();
+        sprintf(tmpbuf, "test.8 Page %u", pageNo);
+        const Page *mapped = file8.mappedPage(pageNo);
+        if ((*iter).getRecord({pageNo, 1}) != tmpbuf ||
+            (mapped == nullptr) != (format == FileFormat::LEGACY) ||
+            (mapped != nullptr && mapped->getRecord({pageNo, 1}) != tmpbuf)) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+        pageCount++;
+      }
+      if (pageCount != (PageId)num - 1) {
+        PRINT_ERROR("ERROR :: Mapped file lost pages");
+      }
+      file8.advise(AccessPattern::SEQUENTIAL);
+      BufMgr mappedBufMgr(num / 4);
+      std::vector<PageRequest> requests;
+      for (PageId pageNo : {1, 2, 3, 50, 51, 99, 100}) {
+        requests.push_back({&file8, pageNo, nullptr});
+      }
+      mappedBufMgr.readPages(requests);
+      for (const PageRequest &request : requests) {
+        sprintf(tmpbuf, "test.8 Page %u", request.pageNo);
+        if (request.page->getRecord({request.pageNo, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      mappedBufMgr.unPinPages(requests, false);
+      if (format == FileFormat::V2) {
+        try {
+          file8.mappedPage(7);
+          PRINT_ERROR(
+              "ERROR :: Page 7 was deleted. Exception should have been "
+              "thrown before execution reaches this point.");
+        } catch (const InvalidPageException &e) {
+        }
+      }
+      try {
+        file8.allocatePage();
+        PRINT_ERROR(
+            "ERROR :: File is read-only. Exception should have been thrown "
+            "before execution reaches this point.");
+      } catch (const ReadOnlyFileException &e) {
+      }
+      try {
+        file8.writePage(file8.readPage(1));
+        PRINT_ERROR(
+            "ERROR :: File is read-only. Exception should have been thrown "
+            "before execution reaches this point.");
+      } catch (const ReadOnlyFileException &e) {
+      }
+    }
+    File::remove(filename);
+  }
+  try {
+    File::create(filename, FileBackend::MMAP);
+    PRINT_ERROR(
+        "ERROR :: Mapped files are read-only. Exception should have been "
+        "thrown before execution reaches this point.");
+  } catch (const ReadOnlyFileException &e) {
+  }
+  if (File::exists(filename)) {
+    PRINT_ERROR("ERROR :: Read-only file was created");
+  }
+
+  std::cout << "Test 21 passed"
+            << "\n";
+}
+
+void test22() {
+  // Deleted slots are reused before the slot array grows, and files older
+  // than format version 3 keep the free space lower bound on disk, their
+  // lists built as pages are read, until they are converted.
+  Page slotted;
+  const SlotId records = 300;
+  for (SlotId k = 1; k <= records; k++) {
+    sprintf(tmpbuf, "record %u", k);
+    if (slotted.insertRecord(tmpbuf).slot_number != k) {
+      PRINT_ERROR("ERROR :: Slot was not appended");
+    }
+  }
+  for (SlotId k = 1; k <= records; k += 2) {
+    slotted.deleteRecord({slotted.page_number(), k});
+  }
+  for (SlotId k = 1; k <= records; k += 2) {
+    const SlotId slot = slotted.insertRecord("reused").slot_number;
+    if (slot % 2 != 1 || slot > records) {
+      PRINT_ERROR("ERROR :: Deleted slot was not reused");
+    }
+  }
+  SlotId recordCount = 0;
+  for (PageIterator iter = slotted.begin(); iter != slotted.end(); ++iter) {
+    recordCount++;
+  }
+  sprintf(tmpbuf, "record %u", records);
+  if (recordCount != records ||
+      slotted.getRecord({slotted.page_number(), records}) != tmpbuf) {
+    PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+  }
+
+  const std::string filename = "test.9";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  PageId pageNo;
+  std::uint16_t freeSpace;
+  {
+    // Legacy files keep the page layout of older builds on disk.
+    File file9 = File::create(filename, FileBackend::POSIX, FileFormat::LEGACY);
+    Page legacyPage = file9.allocatePage();
+    pageNo = legacyPage.page_number();
+    for (SlotId k = 1; k <= 5; k++) {
+      sprintf(tmpbuf, "test.9 record %u", k);
+      legacyPage.insertRecord(tmpbuf);
+    }
+    legacyPage.deleteRecord({pageNo, 2});
+    legacyPage.deleteRecord({pageNo, 4});
+    freeSpace = legacyPage.getFreeSpace();
+    file9.writePage(legacyPage);
+  }
+  {
+    std::ifstream raw(filename, std::ios::binary);
+    std::uint16_t lowerBound = 0;
+    raw.seekg(sizeof(FileHeader) + (pageNo - 1) * Page::SIZE +
+              offsetof(PageHeader, free_slot_head));
+    raw.read(reinterpret_cast<char *>(&lowerBound), sizeof(lowerBound));
+    if (lowerBound != 5 * sizeof(PageSlot)) {
+      PRINT_ERROR("ERROR :: Old page layout was not kept on disk");
+    }
+  }
+  for (FileFormat format : {FileFormat::LEGACY, FileFormat::V2}) {
+    File::convert(filename, format);
+    File file9 = File::open(filename);
+    const std::uint32_t version =
+        format == FileFormat::LEGACY ? 1 : FormatHeader::VERSION;
+    if (file9.formatVersion() != version) {
+      PRINT_ERROR("ERROR :: File was not converted");
+    }
+    Page oldPage = file9.readPage(pageNo);
+    if (oldPage.getFreeSpace() != freeSpace) {
+      PRINT_ERROR("ERROR :: Free space of old page was misread");
+    }
+    const SlotId first = oldPage.insertRecord("again").slot_number;
+    const SlotId second = oldPage.insertRecord("again").slot_number;
+    const SlotId third = oldPage.insertRecord("again").slot_number;
+    if (first + second != 6 || first * second != 8 || third != 6) {
+      PRINT_ERROR("ERROR :: Free slots of old page were not reused");
+    }
+    for (SlotId k : {1, 3, 5}) {
+      sprintf(tmpbuf, "test.9 record %u", k);
+      if (oldPage.getRecord({pageNo, k}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 22 passed"
+            << "\n";
+}
+
+void test23() {
+  // A page whose write back fails stays resident, and under every policy its
+  // frame can still be evicted once the write succeeds again.
+  const std::string filename = "test.10";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  {
+    File file10 = File::create(filename);
+    for (PageId k = 0; k < 6; k++) {
+      Page newPage = file10.allocatePage();
+      sprintf(tmpbuf, "test.10 Page %u", newPage.page_number());
+      newPage.insertRecord(tmpbuf);
+      file10.writePage(newPage);
+    }
+    for (Replacement replacement :
+         {Replacement::CLOCK, Replacement::LRU_K, Replacement::TWO_Q}) {
+      BufMgr failBufMgr(3, replacement);
+      failBufMgr.readPage(file10, 1, page);
+      failBufMgr.unPinPage(file10, 1, true);
+      failBufMgr.readPage(file10, 2, page);
+      failBufMgr.readPage(file10, 3, page);
+      // writing page 1 back fails while it is deleted on disk
+      file10.deletePage(1);
+      try {
+        failBufMgr.readPage(file10, 4, page);
+        PRINT_ERROR(
+            "ERROR :: Page 1 was deleted. Exception should have been thrown "
+            "before execution reaches this point.");
+      } catch (const InvalidPageException &e) {
+      }
+      failBufMgr.unPinPage(file10, 2, false);
+      failBufMgr.unPinPage(file10, 3, false);
+      if (file10.allocatePage().page_number() != 1) {
+        PRINT_ERROR("ERROR :: Deleted page was not reused");
+      }
+      // all three frames are needed, page 1's included
+      for (PageId pageNo = 4; pageNo <= 6; pageNo++) {
+        failBufMgr.readPage(file10, pageNo, page);
+        sprintf(tmpbuf, "test.10 Page %u", pageNo);
+        if (page->getRecord({pageNo, 1}) != tmpbuf) {
+          PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+        }
+      }
+      for (PageId pageNo = 4; pageNo <= 6; pageNo++) {
+        failBufMgr.unPinPage(file10, pageNo, false);
+      }
+      sprintf(tmpbuf, "test.10 Page %u", 1);
+      if (file10.readPage(1).getRecord({1, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: Page 1 was not written back");
+      }
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 23 passed"
+            << "\n";
+}
+
+void test24() {
+  // Each durability policy syncs exactly when it promises to, and the stream
+  // backend's sync through a temporary descriptor neither fails nor leaks it.
+  const std::string filename = "test.11";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  File::create(filename);
+  for (FileBackend backend : {FileBackend::POSIX, FileBackend::STREAM}) {
+    File file11 = File::open(filename, backend);
+    Page newPage = file11.allocatePage();
+    newPage.insertRecord("test.11 Page 1");
+    file11.writePage(newPage);
+    file11.flush();
+    const PageId pageNo = newPage.page_number();
+    // writes, flushes and syncs issued by the writes of body and a flush()
+    auto count = [&](auto body) {
+      const FileStats before = file11.getFileStats();
+      body();
+      file11.flush();
+      const FileStats after = file11.getFileStats();
+      return FileStats{after.writes - before.writes,
+                       after.flushes - before.flushes,
+                       after.syncs - before.syncs};
+    };
+    auto writes = [&](const int times) {
+      for (int k = 0; k < times; k++) {
+        file11.writePage(newPage);
+      }
+    };
+    // each sync, and a flush() that does not sync, flushes the stream once;
+    // only STREAM has a stream to flush
+    auto flushes = [&](const std::uint64_t times) {
+      return backend == FileBackend::STREAM ? times : 0;
+    };
+    // fds are allocated lowest first, so a leaked one shows up here
+    auto nextFd = [] {
+      const int fd = ::open("/dev/null", O_RDONLY);
+      ::close(fd);
+      return fd;
+    };
+    const int firstFd = nextFd();
+
+    file11.setDurability(Durability::NONE);
+    FileStats stats = count([&] { writes(10); });
+    if (stats.writes != 10 || stats.flushes != flushes(1) ||
+        stats.syncs != 0) {
+      PRINT_ERROR("ERROR :: Durability::NONE synced");
+    }
+
+    file11.setDurability(Durability::ON_CLOSE);
+    stats = count([&] {
+      writes(10);
+      if (file11.getFileStats().syncs != 0) {
+        PRINT_ERROR("ERROR :: Durability::ON_CLOSE synced before flush");
+      }
+    });
+    if (stats.writes != 10 || stats.flushes != flushes(1) ||
+        stats.syncs != 1) {
+      PRINT_ERROR("ERROR :: Durability::ON_CLOSE did not sync once");
+    }
+    // nothing was written since
+    stats = count([] {});
+    if (stats.syncs != 0) {
+      PRINT_ERROR("ERROR :: Durability::ON_CLOSE synced with nothing to sync");
+    }
+
+    // every 4th write and the remaining 2 on flush
+    file11.setDurability(Durability::PERIODIC, 4);
+    stats = count([&] { writes(10); });
+    if (stats.writes != 10 || stats.flushes != flushes(3) ||
+        stats.syncs != 3) {
+      PRINT_ERROR("ERROR :: Durability::PERIODIC by writes synced "
+                  << stats.syncs << " times");
+    }
+
+    // the first write after the interval syncs, those before it do not, and
+    // flush() finds nothing left to sync
+    file11.setDurability(Durability::PERIODIC, 0, 200);
+    const std::uint64_t synced = file11.getFileStats().syncs;
+    stats = count([&] {
+      writes(3);
+      if (file11.getFileStats().syncs != synced) {
+        PRINT_ERROR("ERROR :: Durability::PERIODIC synced within interval");
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(250));
+      writes(1);
+    });
+    if (stats.writes != 4 || stats.flushes != flushes(2) ||
+        stats.syncs != 1) {
+      PRINT_ERROR("ERROR :: Durability::PERIODIC by time synced "
+                  << stats.syncs << " times");
+    }
+
+    // flush() finds nothing left to sync
+    file11.setDurability(Durability::EVERY_WRITE);
+    stats = count([&] { writes(10); });
+    if (stats.writes != 10 || stats.flushes != flushes(11) ||
+        stats.syncs != 10) {
+      PRINT_ERROR("ERROR :: Durability::EVERY_WRITE synced " << stats.syncs
+                                                              << " times");
+    }
+
+    if (nextFd() != firstFd) {
+      PRINT_ERROR("ERROR :: Sync leaked a file descriptor");
+    }
+    if (file11.readPage(pageNo).getRecord({pageNo, 1}) != "test.11 Page 1") {
+      PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+    }
+    file11.setDurability(Durability::NONE);
+  }
+  File::remove(filename);
+
+  std::cout << "Test 24 passed"
+            << "\n";
+}
+
+void test25() {
+  // Allocating a page reads nothing from disk; a miss reads the page once.
+  const std::string filename = "test.12";
+  try {
+    File::remove(filename);
+  } catch (const FileNotFoundException &e) {
+  }
+  {
+    File file12 = File::create(filename);
+    Page newPage = file12.allocatePage();
+    newPage.insertRecord("test.12 Page 1");
+    file12.writePage(newPage);
+    BufMgr statsBufMgr(num);
+    statsBufMgr.clearBufStats();
+    statsBufMgr.allocPage(file12, pageno1, page);
+    statsBufMgr.unPinPage(file12, pageno1, false);
+    if (statsBufMgr.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: Allocating a page counted a disk read");
+    }
+    statsBufMgr.readPage(file12, newPage.page_number(), page);
+    statsBufMgr.unPinPage(file12, newPage.page_number(), false);
+    if (statsBufMgr.getBufStats().diskreads != 1) {
+      PRINT_ERROR("ERROR :: A miss counted "
+                  << statsBufMgr.getBufStats().diskreads << " disk reads");
+    }
+  }
+  File::remove(filename);
+
+  std::cout << "Test 25 passed"
+            << "\n";
+}
+
+void test26() {
+  // flushFile() and disposePage() touch only the pages of their own file when
+  // two files with the same page numbers share the pool, interleaved.
+  const std::string filename14 = "test.14";
+  const std::string filename15 = "test.15";
+  const PageId pages = 10;
+  for (const std::string &filename : {filename14, filename15}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+  {
+    File file14 = File::create(filename14);
+    File file15 = File::create(filename15);
+    for (PageId k = 0; k < pages; k++) {
+      for (File *file : {&file14, &file15}) {
+        Page newPage = file->allocatePage();
+        sprintf(tmpbuf, "%s Page %u", file->filename().c_str(),
+                newPage.page_number());
+        newPage.insertRecord(tmpbuf);
+        file->writePage(newPage);
+      }
+    }
+    BufMgr twoFileBufMgr(num);
+    for (PageId pageNo = 1; pageNo <= pages; pageNo++) {
+      for (File *file : {&file14, &file15}) {
+        twoFileBufMgr.readPage(*file, pageNo, page);
+        twoFileBufMgr.unPinPage(*file, pageNo, true);
+      }
+    }
+    twoFileBufMgr.clearBufStats();
+    const FlushReport report = twoFileBufMgr.flushFile(file14);
+    if (report.pages != pages ||
+        twoFileBufMgr.getBufStats().diskwrites != (int)pages) {
+      PRINT_ERROR("ERROR :: flushFile wrote pages of another file");
+    }
+
+    twoFileBufMgr.disposePage(file15, 1);
+    try {
+      twoFileBufMgr.readPage(file15, 1, page);
+      PRINT_ERROR(
+          "ERROR :: Page was disposed. Exception should have been thrown "
+          "before execution reaches this point.");
+    } catch (const InvalidPageException &e) {
+    }
+
+    twoFileBufMgr.clearBufStats();
+    for (PageId pageNo = 2; pageNo <= pages; pageNo++) {
+      twoFileBufMgr.readPage(file15, pageNo, page);
+      sprintf(tmpbuf, "test.15 Page %u", pageNo);
+      if (page->getRecord({pageNo, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      twoFileBufMgr.unPinPage(file15, pageNo, false);
+    }
+    if (twoFileBufMgr.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: Flushing a file dropped pages of another file");
+    }
+    for (PageId pageNo = 1; pageNo <= pages; pageNo++) {
+      twoFileBufMgr.readPage(file14, pageNo, page);
+      sprintf(tmpbuf, "test.14 Page %u", pageNo);
+      if (page->getRecord({pageNo, 1}) != tmpbuf) {
+        PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+      }
+      twoFileBufMgr.unPinPage(file14, pageNo, false);
+    }
+    if (twoFileBufMgr.getBufStats().diskreads != (int)pages) {
+      PRINT_ERROR("ERROR :: Flushed pages were not dropped");
+    }
+    twoFileBufMgr.flushFile(file14);
+    twoFileBufMgr.flushFile(file15);
+  }
+  File::remove(filename14);
+  File::remove(filename15);
+
+  std::cout << "Test 26 passed"
+            << "\n";
+}
+
+void test27() {
+  // Handles open on one path are the same file to the buffer manager; a
+  // handle on another path is not.
+  const std::string filename16 = "test.16";
+  const std::string filename17 = "test.17";
+  for (const std::string &filename : {filename16, filename17}) {
+    try {
+      File::remove(filename);
+    } catch (const FileNotFoundException &e) {
+    }
+  }
+  File::create(filename16).allocatePage();
+  {
+    File first = File::open(filename16);
+    File second = File::open(filename16);
+    File other = File::create(filename17);
+    if (first != second || first.id() != second.id() ||
+        first.id() == File::INVALID_ID) {
+      PRINT_ERROR("ERROR :: Handles on one file differ");
+    }
+    if (first == other || first.id() == other.id()) {
+      PRINT_ERROR("ERROR :: Handles on different files are equal");
+    }
+    BufMgr handleBufMgr(num);
+    handleBufMgr.readPage(first, 1, page);
+    handleBufMgr.unPinPage(second, 1, false);
+    handleBufMgr.clearBufStats();
+    handleBufMgr.readPage(second, 1, page);
+    handleBufMgr.unPinPage(first, 1, false);
+    if (handleBufMgr.getBufStats().diskreads != 0) {
+      PRINT_ERROR("ERROR :: Page read through one handle missed through "
+                  "another");
+    }
+  }
+  File::remove(filename16);
+  File::remove(filename17);
+
+  std::cout << "Test 27 passed"
+            << "\n";
+}
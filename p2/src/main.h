@@ -39,7 +39,7 @@
  *
  * To build and run the system, you need the following packages:
  * <ul>
- *   <li>A modern C++ compiler (GCC >= 4.6, any recent version of clang)
+ *   <li>A C++17 compiler (GCC >= 7, clang >= 5)
  *   <li>Doxygen 1.6 or higher (for generating documentation only)
  * </ul>
  *
@@ -86,7 +86,10 @@
  * and Page.  Files store zero or more fixed-length pages; each page holds zero
  * or more variable-length records.
  *
- * Record data is represented using std::strings of arbitrary characters.
+ * Record data is made of arbitrary characters.  Records are passed in as
+ * std::string_views, so std::strings and string literals can be used directly,
+ * and are read back either as a std::string copy (Page::getRecord) or as a
+ * std::string_view into the page (Page::getRecordView).
  *
  * @subsubsection file_management_sec Creating, opening, and deleting files
  *
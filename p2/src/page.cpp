@@ -9,6 +9,8 @@
 #include "page.h"
 
 #include <cassert>
+#include <cstring>
+#include <functional>
 
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
@@ -21,16 +23,16 @@ namespace badgerdb {
 Page::Page() { initialize(); }
 
 void Page::initialize() {
-  header_.free_space_lower_bound = 0;
+  header_.free_slot_head = INVALID_SLOT;
   header_.free_space_upper_bound = DATA_SIZE;
   header_.num_slots = 0;
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
-  data_.assign(DATA_SIZE, char());
+  std::memset(data_, 0, DATA_SIZE);
 }
 
-RecordId Page::insertRecord(const std::string &record_data) {
+RecordId Page::insertRecord(std::string_view record_data) {
   if (!hasSpaceForRecord(record_data)) {
     throw InsufficientSpaceException(page_number(), record_data.length(),
                                      getFreeSpace());
@@ -41,13 +43,26 @@ RecordId Page::insertRecord(const std::string &record_data) {
 }
 
 std::string Page::getRecord(const RecordId &record_id) const {
+  return std::string(getRecordView(record_id));
+}
+
+std::string_view Page::getRecordView(const RecordId &record_id) const {
   validateRecordId(record_id);
   const PageSlot *slot = getSlot(record_id.slot_number);
-  return data_.substr(slot->item_offset, slot->item_length);
+  return std::string_view(data_ + slot->item_offset, slot->item_length);
 }
 
 void Page::updateRecord(const RecordId &record_id,
-                        const std::string &record_data) {
+                        std::string_view record_data) {
+  // std::less gives a total order even over pointers into unrelated objects.
+  const std::less<const char *> before;
+  if (!before(record_data.data(), data_) &&
+      before(record_data.data(), data_ + DATA_SIZE)) {
+    // The new data lives on this page and would be moved by the delete below.
+    const std::string record_copy(record_data);
+    updateRecord(record_id, std::string_view(record_copy));
+    return;
+  }
   validateRecordId(record_id);
   const PageSlot *slot = getSlot(record_id.slot_number);
   const std::size_t free_space_after_delete =
@@ -71,12 +86,16 @@ void Page::deleteRecord(const RecordId &record_id,
                         const bool allow_slot_compaction) {
   validateRecordId(record_id);
   PageSlot *slot = getSlot(record_id.slot_number);
-  data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
+  std::memset(data_ + slot->item_offset, 0, slot->item_length);
 
   // Compact the data by removing the hole left by this record (if necessary).
+  // Nothing lies below the lowest record, which is often the one most
+  // recently inserted, so it needs no walk over the slots.
   std::uint16_t move_offset = slot->item_offset;
   std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+  const bool walk = slot->item_length > 0 &&
+                    slot->item_offset != header_.free_space_upper_bound;
+  for (SlotId i = 1; walk && i <= header_.num_slots; ++i) {
     PageSlot *other_slot = getSlot(i);
     if (other_slot->used && other_slot->item_offset < slot->item_offset) {
       if (other_slot->item_offset < move_offset) {
@@ -90,39 +109,29 @@ void Page::deleteRecord(const RecordId &record_id,
   }
   // If we have data to move, shift it to the right.
   if (move_bytes > 0) {
-    const std::string &data_to_move = data_.substr(move_offset, move_bytes);
-    data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+    std::memmove(data_ + move_offset + slot->item_length, data_ + move_offset,
+                 move_bytes);
   }
   header_.free_space_upper_bound += slot->item_length;
 
   // Mark slot as unused.
   slot->used = false;
-  slot->item_offset = 0;
-  slot->item_length = 0;
+  pushFreeSlot(record_id.slot_number);
   ++header_.num_free_slots;
 
   if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
     // Last slot in the list, so we need to free any unused slots that are at
-    // the end of the slot list.
-    int num_slots_to_delete = 1;
-    for (SlotId i = 1; i < header_.num_slots; ++i) {
-      // Traverse list backwards, looking for unused slots.
-      const PageSlot *other_slot = getSlot(header_.num_slots - i);
-      if (!other_slot->used) {
-        ++num_slots_to_delete;
-      } else {
-        // Stop at the first used slot we find, since we can't move used
-        // slots without affecting record IDs.
-        break;
-      }
+    // the end of the slot list.  Stop at the first used slot we find, since
+    // we can't move used slots without affecting record IDs.
+    while (header_.num_slots > 0 && !getSlot(header_.num_slots)->used) {
+      unlinkFreeSlot(header_.num_slots);
+      --header_.num_slots;
+      --header_.num_free_slots;
     }
-    header_.num_slots -= num_slots_to_delete;
-    header_.num_free_slots -= num_slots_to_delete;
-    header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
   }
 }
 
-bool Page::hasSpaceForRecord(const std::string &record_data) const {
+bool Page::hasSpaceForRecord(std::string_view record_data) const {
   std::size_t record_size = record_data.length();
   if (header_.num_free_slots == 0) {
     record_size += sizeof(PageSlot);
@@ -140,32 +149,56 @@ const PageSlot *Page::getSlot(const SlotId slot_number) const {
       &data_[(slot_number - 1) * sizeof(PageSlot)]);
 }
 
-SlotId Page::getAvailableSlot() {
-  SlotId slot_number = INVALID_SLOT;
-  if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot *slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone
-        // actually puts data in the slot.
-        slot_number = i;
-        break;
-      }
+void Page::rebuildFreeSlotList() {
+  header_.free_slot_head = INVALID_SLOT;
+  for (SlotId i = header_.num_slots; i > 0; --i) {
+    if (!getSlot(i)->used) {
+      pushFreeSlot(i);
     }
+  }
+}
+
+void Page::pushFreeSlot(const SlotId slot_number) {
+  PageSlot *slot = getSlot(slot_number);
+  slot->item_offset = header_.free_slot_head;
+  slot->item_length = INVALID_SLOT;
+  if (header_.free_slot_head != INVALID_SLOT) {
+    getSlot(header_.free_slot_head)->item_length = slot_number;
+  }
+  header_.free_slot_head = slot_number;
+}
+
+void Page::unlinkFreeSlot(const SlotId slot_number) {
+  PageSlot *slot = getSlot(slot_number);
+  const SlotId next = slot->item_offset;
+  const SlotId previous = slot->item_length;
+  if (previous == INVALID_SLOT) {
+    header_.free_slot_head = next;
   } else {
+    getSlot(previous)->item_offset = next;
+  }
+  if (next != INVALID_SLOT) {
+    getSlot(next)->item_length = previous;
+  }
+}
+
+SlotId Page::getAvailableSlot() {
+  if (header_.free_slot_head == INVALID_SLOT) {
     // Have to allocate a new slot.
-    slot_number = header_.num_slots + 1;
     ++header_.num_slots;
     ++header_.num_free_slots;
-    header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    getSlot(header_.num_slots)->used = false;
+    pushFreeSlot(header_.num_slots);
   }
+  // We don't take the slot off the list or decrement the number of free
+  // slots until someone actually puts data in the slot.
+  const SlotId slot_number = header_.free_slot_head;
   assert(slot_number != INVALID_SLOT);
   return slot_number;
 }
 
 void Page::insertRecordInSlot(const SlotId slot_number,
-                              const std::string &record_data) {
+                              std::string_view record_data) {
   if (slot_number > header_.num_slots || slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
   }
@@ -173,13 +206,15 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   if (slot->used) {
     throw SlotInUseException(page_number(), slot_number);
   }
+  unlinkFreeSlot(slot_number);
   const int record_length = record_data.length();
   slot->used = true;
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
   --header_.num_free_slots;
-  data_.replace(slot->item_offset, slot->item_length, record_data);
+  std::memcpy(data_ + slot->item_offset, record_data.data(),
+              slot->item_length);
 }
 
 void Page::validateRecordId(const RecordId &record_id) const {
@@ -11,8 +11,9 @@
 #include <stdint.h>
 
 #include <cstddef>
-#include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 #include "types.h"
 
@@ -26,10 +27,13 @@ namespace badgerdb {
  */
 struct PageHeader {
   /**
-   * Lower bound of the free space.  This is the offset of the first unused byte
-   * after the slot array.
+   * First slot of the list of slots allocated but not in use, or
+   * Page::INVALID_SLOT if there are none.  On disk, files older than format
+   * version 3 hold the lower bound of the free space here instead,
+   * num_slots * sizeof(PageSlot); File converts as it reads and writes their
+   * pages.
    */
-  std::uint16_t free_space_lower_bound;
+  std::uint16_t free_slot_head;
 
   /**
    * Upper bound of the free space.  This is the offset of the last unused byte
@@ -74,6 +78,9 @@ struct PageHeader {
 
 /**
  * @brief Slot metadata that tracks where a record is in the data space.
+ *
+ * An unused slot is instead a link of the page's doubly linked list of free
+ * slots.
  */
 struct PageSlot {
   /**
@@ -83,12 +90,13 @@ struct PageSlot {
   bool used;
 
   /**
-   * Offset of the data item in the page.
+   * Offset of the data item in the page, or the next free slot if unused.
    */
   std::uint16_t item_offset;
 
   /**
-   * Length of the data item in this slot.
+   * Length of the data item in this slot, or the previous free slot if
+   * unused.
    */
   std::uint16_t item_length;
 };
@@ -103,9 +111,14 @@ class PageIterator;
  * slots and identified by a RecordId.  Although a record's actual contents may
  * be moved on the page, accessing a record by its slot is consistent.
  *
+ * A Page object is exactly the on-disk image of the page: the header followed
+ * by the data area in one trivially copyable, aligned block.  Pages can be
+ * read from and written to disk in a single transfer, and copying one never
+ * allocates.
+ *
  * @warning This class is not threadsafe.
  */
-class Page {
+class alignas(4096) Page {
  public:
   /**
    * Page size in bytes.  If this is changed, database files created with a
@@ -139,18 +152,30 @@ class Page {
    * @param record_data  Bytes that compose the record.
    * @return  ID of the newly inserted record.
    */
-  RecordId insertRecord(const std::string &record_data);
+  RecordId insertRecord(std::string_view record_data);
 
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
    *
+   * @see getRecordView
    * @see updateRecord
    * @param record_id  ID of the record to return.
    * @return  The record.
    */
   std::string getRecord(const RecordId &record_id) const;
 
+  /**
+   * Returns a view of the record with the given ID without copying it.  The
+   * view points into the page and is only valid until the page is modified,
+   * or, for a page in the buffer pool, until the page is unpinned.
+   *
+   * @see getRecord
+   * @param record_id  ID of the record to return.
+   * @return  View of the record's bytes on the page.
+   */
+  std::string_view getRecordView(const RecordId &record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -159,7 +184,7 @@ class Page {
    * @param record_id   ID of record to update.
    * @param record_data Updated bytes that compose the record.
    */
-  void updateRecord(const RecordId &record_id, const std::string &record_data);
+  void updateRecord(const RecordId &record_id, std::string_view record_data);
 
   /**
    * Deletes the record with the given ID.  Page is compacted upon delete to
@@ -176,7 +201,7 @@ class Page {
    * @param record_data Bytes that compose the record.
    * @return  Whether the page can hold the data.
    */
-  bool hasSpaceForRecord(const std::string &record_data) const;
+  bool hasSpaceForRecord(std::string_view record_data) const;
 
   /**
    * Returns this page's free space in bytes.
@@ -184,7 +209,8 @@ class Page {
    * @return  Free space in bytes.
    */
   std::uint16_t getFreeSpace() const {
-    return header_.free_space_upper_bound - header_.free_space_lower_bound;
+    return header_.free_space_upper_bound -
+           header_.num_slots * sizeof(PageSlot);
   }
 
   /**
@@ -274,10 +300,30 @@ class Page {
   const PageSlot *getSlot(const SlotId slot_number) const;
 
   /**
-   * Returns the slot number of an available slot.  If no slots are available
-   * to be reused, allocates a new slot.  Updates available slot count in the
-   * header metadata, but does not mark returned slot as used.  If a new slot is
-   * allocated, updates the free space lower bound.
+   * Builds the free slot list from scratch by walking the slots, for a page
+   * read from a file that does not store the list.
+   */
+  void rebuildFreeSlotList();
+
+  /**
+   * Adds an unused slot to the head of the free slot list.
+   *
+   * @param slot_number   Number of slot to add.
+   */
+  void pushFreeSlot(const SlotId slot_number);
+
+  /**
+   * Removes a slot from the free slot list.
+   *
+   * @param slot_number   Number of slot to remove.
+   */
+  void unlinkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Returns the slot number of an available slot: the head of the free slot
+   * list, or if no slots are available to be reused, a newly allocated slot.
+   * Updates available slot count in the header metadata, but does not mark
+   * returned slot as used.
    *
    * Callers are responsible for making sure there is enough space to allocate a
    * new slot before calling this method.
@@ -303,7 +349,7 @@ class Page {
    * @throws  SlotInUseException  Thrown when given slot is in use.
    */
   void insertRecordInSlot(const SlotId slot_number,
-                          const std::string &record_data);
+                          std::string_view record_data);
 
   /**
    * Throws an exception if the given record ID is not valid for this page
@@ -331,8 +377,7 @@ class Page {
    * Data stored on the page.  Includes bookkeeping information about slots as
    * well as actual content.
    */
-
-  std::string data_;
+  char data_[DATA_SIZE];
 
   friend class File;
   friend class PageIterator;
@@ -343,5 +388,9 @@ class Page {
 static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0, "Page must have some space to hold data.");
+static_assert(sizeof(Page) == Page::SIZE,
+              "Page must be laid out exactly as it is stored on disk.");
+static_assert(std::is_trivially_copyable<Page>::value,
+              "Page must be copyable as a block of bytes.");
 
 }  // namespace badgerdb
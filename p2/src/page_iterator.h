@@ -9,6 +9,7 @@
 #pragma once
 
 #include <cassert>
+#include <string_view>
 
 #include "file.h"
 #include "page.h"
@@ -90,13 +91,14 @@ class PageIterator {
   }
 
   /**
-   * Dereferences the iterator, returning a copy of the current record in the
-   * page.
+   * Dereferences the iterator, returning a view of the current record in the
+   * page.  The view is valid as long as the page is not modified (or, for a
+   * page in the buffer pool, unpinned).
    *
    * @return  Record in page.
    */
-  inline std::string operator*() const {
-    return page_->getRecord(current_record_);
+  inline std::string_view operator*() const {
+    return page_->getRecordView(current_record_);
   }
 
   /**
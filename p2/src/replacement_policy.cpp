@@ -0,0 +1,289 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#include "replacement_policy.h"
+
+#include <algorithm>
+
+#include "buffer.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Offers the frames of a free list to tryClaim and removes the one claimed.
+ */
+bool claimFree(std::vector<FrameId>& freeFrames,
+               const std::function<bool(FrameId)>& tryClaim, FrameId& frame) {
+  for (std::size_t i = freeFrames.size(); i-- > 0;) {
+    if (tryClaim(freeFrames[i])) {
+      frame = freeFrames[i];
+      freeFrames[i] = freeFrames.back();
+      freeFrames.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+//----------------------------------------
+// ClockPolicy
+//----------------------------------------
+
+ClockPolicy::ClockPolicy(std::deque<BufDesc>& descs)
+    : descs(descs), clockHand(descs.size() - 1) {}
+
+FrameId ClockPolicy::advanceClock() {
+  FrameId hand = clockHand.load();
+  FrameId next;
+  do {
+    next = (hand + 1) % descs.size();
+  } while (!clockHand.compare_exchange_weak(hand, next));
+  return next;
+}
+
+bool ClockPolicy::pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                             FrameId& frame) {
+  // Two revolutions clear every refbit and then revisit each frame, so if
+  // nothing could be claimed by then every frame is pinned or in use.
+  for (std::size_t i = 0; i <= 2 * descs.size(); i++) {
+    const FrameId candidate = advanceClock();
+    // if refbit is set, flip it and give the page another chance
+    if (descs[candidate].refbit.exchange(false)) {
+      continue;
+    }
+    if (tryClaim(candidate)) {
+      frame = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockPolicy::loaded(const FrameId frame) { descs[frame].refbit = true; }
+
+void ClockPolicy::loadedCold(const FrameId frame) {
+  descs[frame].refbit = false;
+}
+
+void ClockPolicy::accessed(const FrameId frame) { descs[frame].refbit = true; }
+
+void ClockPolicy::freed(const FrameId frame) { descs[frame].refbit = false; }
+
+void ClockPolicy::resize(const std::uint32_t numBufs) {
+  // the descriptors are resized by BufMgr; keep the hand on a frame
+  clockHand = clockHand % numBufs;
+}
+
+//----------------------------------------
+// LruKPolicy
+//----------------------------------------
+
+LruKPolicy::LruKPolicy(const std::uint32_t numBufs)
+    : clock(0), history(numBufs * K, 0), state(numBufs, FREE) {
+  for (FrameId i = numBufs; i-- > 0;) {
+    freeFrames.push_back(i);
+  }
+}
+
+LruKPolicy::OrderKey LruKPolicy::orderKey(const FrameId frame) const {
+  return OrderKey(history[frame * K + K - 1], history[frame * K], frame);
+}
+
+bool LruKPolicy::pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                            FrameId& frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (claimFree(freeFrames, tryClaim, frame)) {
+    state[frame] = CLAIMED;
+    return true;
+  }
+  for (auto it = order.begin(); it != order.end(); ++it) {
+    if (tryClaim(std::get<2>(*it))) {
+      frame = std::get<2>(*it);
+      order.erase(it);
+      state[frame] = CLAIMED;
+      return true;
+    }
+  }
+  return false;
+}
+
+void LruKPolicy::makeResident(const FrameId frame, const std::uint64_t time) {
+  if (state[frame] == RESIDENT) {
+    return;
+  }
+  if (state[frame] == FREE) {
+    freeFrames.erase(
+        std::find(freeFrames.begin(), freeFrames.end(), frame));
+  }
+  // the history of a frame belongs to the page it held, so start afresh
+  std::fill(history.begin() + frame * K, history.begin() + (frame + 1) * K, 0);
+  history[frame * K] = time;
+  state[frame] = RESIDENT;
+  order.insert(orderKey(frame));
+}
+
+void LruKPolicy::loaded(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  makeResident(frame, ++clock);
+}
+
+void LruKPolicy::loadedCold(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  // with no recorded access the frame sorts before every other one
+  makeResident(frame, 0);
+}
+
+void LruKPolicy::accessed(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  // a frame being evicted or reloaded keeps no history
+  if (state[frame] != RESIDENT) {
+    return;
+  }
+  order.erase(orderKey(frame));
+  std::copy_backward(history.begin() + frame * K,
+                     history.begin() + (frame + 1) * K - 1,
+                     history.begin() + (frame + 1) * K);
+  history[frame * K] = ++clock;
+  order.insert(orderKey(frame));
+}
+
+void LruKPolicy::freed(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (state[frame] == FREE) {
+    return;
+  }
+  if (state[frame] == RESIDENT) {
+    order.erase(orderKey(frame));
+  }
+  state[frame] = FREE;
+  freeFrames.push_back(frame);
+}
+
+void LruKPolicy::resize(const std::uint32_t numBufs) {
+  std::lock_guard<std::mutex> guard(latch);
+  const std::uint32_t oldNumBufs = state.size();
+  freeFrames.erase(std::remove_if(freeFrames.begin(), freeFrames.end(),
+                                  [&](FrameId f) { return f >= numBufs; }),
+                   freeFrames.end());
+  history.resize(numBufs * K, 0);
+  state.resize(numBufs, FREE);
+  for (FrameId i = oldNumBufs; i < numBufs; i++) {
+    freeFrames.push_back(i);
+  }
+}
+
+//----------------------------------------
+// TwoQPolicy
+//----------------------------------------
+
+TwoQPolicy::TwoQPolicy(const std::uint32_t numBufs)
+    : a1Target(std::max<std::uint32_t>(1, numBufs / 4)),
+      queueOf(numBufs, FREE),
+      position(numBufs) {
+  for (FrameId i = numBufs; i-- > 0;) {
+    freeFrames.push_back(i);
+  }
+}
+
+void TwoQPolicy::unlink(const FrameId frame) {
+  if (queueOf[frame] == A1) {
+    a1.erase(position[frame]);
+  } else if (queueOf[frame] == AM) {
+    am.erase(position[frame]);
+  } else if (queueOf[frame] == FREE) {
+    freeFrames.erase(
+        std::find(freeFrames.begin(), freeFrames.end(), frame));
+  }
+  queueOf[frame] = CLAIMED;
+}
+
+bool TwoQPolicy::claimFrom(std::list<FrameId>& queue,
+                           const std::function<bool(FrameId)>& tryClaim,
+                           FrameId& frame) {
+  for (auto it = queue.begin(); it != queue.end(); ++it) {
+    if (tryClaim(*it)) {
+      frame = *it;
+      queue.erase(it);
+      queueOf[frame] = CLAIMED;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TwoQPolicy::pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                            FrameId& frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (claimFree(freeFrames, tryClaim, frame)) {
+    queueOf[frame] = CLAIMED;
+    return true;
+  }
+  if (a1.size() > a1Target) {
+    return claimFrom(a1, tryClaim, frame) || claimFrom(am, tryClaim, frame);
+  }
+  return claimFrom(am, tryClaim, frame) || claimFrom(a1, tryClaim, frame);
+}
+
+void TwoQPolicy::enqueue(const FrameId frame, const bool cold) {
+  if (queueOf[frame] == A1 || queueOf[frame] == AM) {
+    return;
+  }
+  unlink(frame);
+  queueOf[frame] = A1;
+  position[frame] = a1.insert(cold ? a1.begin() : a1.end(), frame);
+}
+
+void TwoQPolicy::loaded(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  enqueue(frame, false);
+}
+
+void TwoQPolicy::loadedCold(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  enqueue(frame, true);
+}
+
+void TwoQPolicy::accessed(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (queueOf[frame] != A1 && queueOf[frame] != AM) {
+    return;
+  }
+  unlink(frame);
+  queueOf[frame] = AM;
+  position[frame] = am.insert(am.end(), frame);
+}
+
+void TwoQPolicy::freed(const FrameId frame) {
+  std::lock_guard<std::mutex> guard(latch);
+  if (queueOf[frame] == FREE) {
+    return;
+  }
+  unlink(frame);
+  queueOf[frame] = FREE;
+  freeFrames.push_back(frame);
+}
+
+void TwoQPolicy::resize(const std::uint32_t numBufs) {
+  std::lock_guard<std::mutex> guard(latch);
+  const std::uint32_t oldNumBufs = queueOf.size();
+  freeFrames.erase(std::remove_if(freeFrames.begin(), freeFrames.end(),
+                                  [&](FrameId f) { return f >= numBufs; }),
+                   freeFrames.end());
+  queueOf.resize(numBufs, FREE);
+  position.resize(numBufs);
+  for (FrameId i = oldNumBufs; i < numBufs; i++) {
+    freeFrames.push_back(i);
+  }
+  a1Target = std::max<std::uint32_t>(1, numBufs / 4);
+}
+
+}  // namespace badgerdb
@@ -0,0 +1,324 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University
+ * of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+class BufDesc;
+
+/**
+ * @brief Buffer replacement algorithms BufMgr can be constructed with.
+ */
+enum class Replacement {
+  /**
+   * Clock with one reference bit per frame.
+   */
+  CLOCK,
+
+  /**
+   * LRU-2: evicts the page whose second most recent access is oldest, so
+   * pages touched only once (such as by a scan) go before the working set.
+   */
+  LRU_K,
+
+  /**
+   * Simplified 2Q: pages enter a FIFO queue and are promoted to an LRU queue
+   * when accessed again; the FIFO queue is drained first while it holds more
+   * than a quarter of the pool.
+   */
+  TWO_Q
+};
+
+/**
+ * @brief Interface through which BufMgr picks frames to evict.
+ *
+ * BufMgr tells the policy when a frame is loaded with a page, when the page
+ * is accessed again and when the frame is freed, and asks it for a victim
+ * when it needs a frame.  Implementations must be safe to call from several
+ * threads at once.
+ */
+class ReplacementPolicy {
+ public:
+  /**
+   * Destructor of ReplacementPolicy class
+   */
+  virtual ~ReplacementPolicy() {}
+
+  /**
+   * Offers frames to tryClaim in eviction order until it accepts one.  Free
+   * frames are offered first.  tryClaim must not block; it returns true once
+   * it has claimed the frame, after which the policy treats the frame as free
+   * until it is loaded() again.
+   *
+   * @param tryClaim  Called with candidate frames; returns true to take one.
+   * @param frame     Claimed frame returned via this variable
+   * @return  False if no frame was claimed
+   */
+  virtual bool pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                          FrameId& frame) = 0;
+
+  /**
+   * Records that a frame was loaded with a page, which counts as its first
+   * access.
+   *
+   * @param frame   Frame that was loaded
+   */
+  virtual void loaded(const FrameId frame) = 0;
+
+  /**
+   * Records that a frame was loaded with a page that is not expected to be
+   * accessed again, placing it first in eviction order.
+   *
+   * @param frame   Frame that was loaded
+   */
+  virtual void loadedCold(const FrameId frame) = 0;
+
+  /**
+   * Records another access to the page in a frame.
+   *
+   * @param frame   Frame whose page was accessed
+   */
+  virtual void accessed(const FrameId frame) = 0;
+
+  /**
+   * Records that a frame no longer holds a page.
+   *
+   * @param frame   Frame that was freed
+   */
+  virtual void freed(const FrameId frame) = 0;
+
+  /**
+   * Changes the number of frames.  Called with no other call in progress;
+   * frames beyond a smaller size have all been freed().  New frames are
+   * free.
+   *
+   * @param numBufs New number of frames in the buffer pool
+   */
+  virtual void resize(const std::uint32_t numBufs) = 0;
+};
+
+/**
+ * @brief Clock replacement using the refbit of each frame's BufDesc.
+ *
+ * The hand is advanced with compare-and-swap and refbits are atomic, so the
+ * sweep takes no latches.
+ */
+class ClockPolicy : public ReplacementPolicy {
+ public:
+  /**
+   * Constructor of ClockPolicy class
+   *
+   * @param descs   Descriptors of the frames of the buffer pool
+   */
+  explicit ClockPolicy(std::deque<BufDesc>& descs);
+
+  bool pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                  FrameId& frame) override;
+  void loaded(const FrameId frame) override;
+  void loadedCold(const FrameId frame) override;
+  void accessed(const FrameId frame) override;
+  void freed(const FrameId frame) override;
+  void resize(const std::uint32_t numBufs) override;
+
+ private:
+  /**
+   * Advance clock to next frame in the buffer pool
+   *
+   * @return  Frame the clock hand now points at
+   */
+  FrameId advanceClock();
+
+  /**
+   * Descriptors of the frames of the buffer pool
+   */
+  std::deque<BufDesc>& descs;
+
+  /**
+   * Current position of clockhand in our buffer pool
+   */
+  std::atomic<FrameId> clockHand;
+};
+
+/**
+ * @brief LRU-K replacement with K = 2.
+ *
+ * Frames are kept ordered by the time of their K-th most recent access;
+ * frames with fewer than K accesses come first, by their latest access.
+ */
+class LruKPolicy : public ReplacementPolicy {
+ public:
+  /**
+   * Number of accesses remembered per frame
+   */
+  static const int K = 2;
+
+  /**
+   * Constructor of LruKPolicy class
+   *
+   * @param numBufs Number of frames in the buffer pool
+   */
+  explicit LruKPolicy(const std::uint32_t numBufs);
+
+  bool pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                  FrameId& frame) override;
+  void loaded(const FrameId frame) override;
+  void loadedCold(const FrameId frame) override;
+  void accessed(const FrameId frame) override;
+  void freed(const FrameId frame) override;
+  void resize(const std::uint32_t numBufs) override;
+
+ private:
+  /**
+   * Whether a frame is on the free list, claimed by BufMgr or holds a page
+   */
+  enum State { FREE, CLAIMED, RESIDENT };
+
+  /**
+   * (K-th most recent access or 0, most recent access, frame)
+   */
+  typedef std::tuple<std::uint64_t, std::uint64_t, FrameId> OrderKey;
+
+  /**
+   * Returns the position of a frame in the eviction order.
+   */
+  OrderKey orderKey(const FrameId frame) const;
+
+  /**
+   * Makes a claimed or free frame resident with the given latest access.
+   */
+  void makeResident(const FrameId frame, const std::uint64_t time);
+
+  /**
+   * Logical time, advanced on every access
+   */
+  std::uint64_t clock;
+
+  /**
+   * Access times of each frame's page, most recent first; 0 if none
+   */
+  std::vector<std::uint64_t> history;
+
+  /**
+   * State of each frame
+   */
+  std::vector<State> state;
+
+  /**
+   * Frames holding no page
+   */
+  std::vector<FrameId> freeFrames;
+
+  /**
+   * Resident frames in eviction order
+   */
+  std::set<OrderKey> order;
+
+  /**
+   * Protects all of the above
+   */
+  std::mutex latch;
+};
+
+/**
+ * @brief Simplified 2Q replacement.
+ *
+ * Newly loaded pages enter the A1 FIFO queue; a page accessed again while in
+ * A1 moves to the Am LRU queue.  Victims come from A1 while it holds more
+ * than a quarter of the pool, otherwise from the cold end of Am.  No history
+ * of evicted pages is kept.
+ */
+class TwoQPolicy : public ReplacementPolicy {
+ public:
+  /**
+   * Constructor of TwoQPolicy class
+   *
+   * @param numBufs Number of frames in the buffer pool
+   */
+  explicit TwoQPolicy(const std::uint32_t numBufs);
+
+  bool pickVictim(const std::function<bool(FrameId)>& tryClaim,
+                  FrameId& frame) override;
+  void loaded(const FrameId frame) override;
+  void loadedCold(const FrameId frame) override;
+  void accessed(const FrameId frame) override;
+  void freed(const FrameId frame) override;
+  void resize(const std::uint32_t numBufs) override;
+
+ private:
+  /**
+   * Queue a frame is in; CLAIMED frames are in none
+   */
+  enum Queue { FREE, CLAIMED, A1, AM };
+
+  /**
+   * Removes a frame from the queue it is in, if any.
+   */
+  void unlink(const FrameId frame);
+
+  /**
+   * Puts a claimed or free frame into A1, at its old end if cold.
+   */
+  void enqueue(const FrameId frame, const bool cold);
+
+  /**
+   * Offers the frames of a queue, oldest first, to tryClaim.
+   */
+  bool claimFrom(std::list<FrameId>& queue,
+                 const std::function<bool(FrameId)>& tryClaim,
+                 FrameId& frame);
+
+  /**
+   * Largest size of A1 at which victims are taken from Am first
+   */
+  std::uint32_t a1Target;
+
+  /**
+   * FIFO queue of pages accessed once, oldest first
+   */
+  std::list<FrameId> a1;
+
+  /**
+   * LRU queue of pages accessed more than once, least recent first
+   */
+  std::list<FrameId> am;
+
+  /**
+   * Queue each frame is in
+   */
+  std::vector<Queue> queueOf;
+
+  /**
+   * Position of each frame in its queue
+   */
+  std::vector<std::list<FrameId>::iterator> position;
+
+  /**
+   * Frames holding no page
+   */
+  std::vector<FrameId> freeFrames;
+
+  /**
+   * Protects all of the above
+   */
+  std::mutex latch;
+};
+
+}  // namespace badgerdb
@@ -22,6 +22,12 @@ typedef std::uint32_t PageId;
  */
 typedef std::uint16_t SlotId;
 
+/**
+ * @brief Identifier for an open file.  Assigned when a file is first opened
+ * and shared by every File object referring to it.
+ */
+typedef std::uint32_t FileId;
+
 /**
  * @brief Identifier for a frame in buffer pool.
  */